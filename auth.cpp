@@ -0,0 +1,109 @@
+#include "headers/auth.hpp"
+#include "headers/cenv.hpp"
+#include "headers/lru.hpp"
+#include <jwt-cpp/jwt.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+namespace {
+
+struct VerifiedToken {
+    std::string subject;
+    std::chrono::system_clock::time_point expires;
+    std::uint64_t generation; // signing key it was verified against
+};
+
+// Tokens without an exp claim are re-verified at least this often
+constexpr auto kMaxCacheLifetime = std::chrono::minutes(10);
+
+ShardedLru<std::string, VerifiedToken>& token_cache() {
+    static ShardedLru<std::string, VerifiedToken> cache(16, 4096);
+    return cache;
+}
+
+// SHA-256 of the raw token; keys never hold a usable credential
+std::string digest(const std::string& token) {
+    unsigned char out[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(token.data()), token.size(), out);
+    return std::string(reinterpret_cast<const char*>(out), sizeof(out));
+}
+
+using Verifier = std::decay_t<decltype(jwt::verify().allow_algorithm(jwt::algorithm::hs256{std::string()}))>;
+
+struct SigningKey {
+    std::string secret;
+    std::uint64_t generation;
+    Verifier verifier; // verify() is const and safe to share between threads
+};
+
+// Follows [secrets] securekey in the live cenv snapshot. A rotated key gets a
+// new generation and empties the token cache, so tokens verified under the
+// old key have to pass the new one before they are accepted again.
+std::shared_ptr<const SigningKey> signing_key() {
+    static std::mutex mtx;
+    static std::shared_ptr<const SigningKey> current;
+
+    std::string secret = atlas_cenv().find_token("secrets", "securekey");
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!current || current->secret != secret) {
+        std::uint64_t generation = current ? current->generation + 1 : 0;
+        if (current) token_cache().clear();
+
+        current = std::make_shared<const SigningKey>(SigningKey{
+            secret,
+            generation,
+            jwt::verify().allow_algorithm(jwt::algorithm::hs256{secret})
+        });
+    }
+    return current;
+}
+
+}
+
+std::string jwt_secret() {
+    return signing_key()->secret;
+}
+
+std::string decode_token(const std::string& token) {
+    auto now = std::chrono::system_clock::now();
+    std::string key = digest(token);
+    auto signing = signing_key();
+
+    // An entry from before a rotation can land after the clear; the generation catches it
+    if (auto cached = token_cache().get(key)) {
+        if (now < cached->expires && cached->generation == signing->generation) {
+            return cached->subject;
+        }
+        token_cache().erase(key);
+    }
+
+    auto decoded = jwt::decode(token);
+    signing->verifier.verify(decoded);
+
+    auto expires = now + kMaxCacheLifetime;
+    if (decoded.has_expires_at()) {
+        expires = std::min(expires, decoded.get_expires_at());
+    }
+
+    std::string subject = decoded.get_subject();
+    token_cache().put(key, {subject, expires, signing->generation});
+
+    return subject;
+}
+
+json token_cache_stats() {
+    auto stats = token_cache().stats();
+
+    return json{
+        {"hits", stats.hits},
+        {"misses", stats.misses},
+        {"evictions", stats.evictions},
+        {"size", stats.size}
+    };
+}
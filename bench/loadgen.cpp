@@ -0,0 +1,472 @@
+// Load generator for atlas_server. Drives the main HTTP routes over keep-alive
+// connections and measures WebSocket broadcast latency with N clients that
+// all join one server and send to it.
+//
+//   cmake -S . -B build -DATLAS_BUILD_BENCH=ON && cmake --build build
+//   psql atlas_bench -f bench/schema.sql        # scratch database, see file
+//   ./build/atlas_server &                      # or --storage memory, seeded with bench-server
+//   ./build/atlas_loadgen --connections 16 --duration 10 --ws-clients 50 --rate 2
+//
+// Run it against a build and a database you do not care about: it signs up
+// bench_<n> users and floods bench-server with messages.
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+
+using tcp = net::ip::tcp;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::string server = "bench-server";
+    std::string password = "bench-password";
+    int users = 20;
+    int connections = 8;
+    int duration = 10;     // seconds per phase
+    int ws_clients = 20;
+    double rate = 2.0;     // messages per second per WebSocket client
+};
+
+//------------------------------------------------------------
+// Samples and reporting
+//------------------------------------------------------------
+struct Samples {
+    std::vector<std::uint32_t> us;
+    std::uint64_t errors = 0;
+
+    void merge(const Samples& other) {
+        us.insert(us.end(), other.us.begin(), other.us.end());
+        errors += other.errors;
+    }
+};
+
+static std::uint32_t elapsed_us(Clock::time_point start) {
+    return static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+}
+
+static double percentile_ms(const std::vector<std::uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    std::size_t index = std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()));
+    return sorted[index] / 1000.0;
+}
+
+static void print_header() {
+    std::printf("%-32s %10s %10s %9s %9s %9s %8s\n", "scenario", "samples", "per_sec", "p50_ms", "p99_ms", "p999_ms", "errors");
+}
+
+static void print_row(const std::string& name, Samples samples, double seconds) {
+    std::sort(samples.us.begin(), samples.us.end());
+
+    std::printf("%-32s %10zu %10.1f %9.2f %9.2f %9.2f %8llu\n",
+                name.c_str(),
+                samples.us.size(),
+                seconds > 0 ? samples.us.size() / seconds : 0.0,
+                percentile_ms(samples.us, 0.50),
+                percentile_ms(samples.us, 0.99),
+                percentile_ms(samples.us, 0.999),
+                static_cast<unsigned long long>(samples.errors));
+}
+
+//------------------------------------------------------------
+// HTTP (synchronous, one keep-alive connection per thread)
+//------------------------------------------------------------
+class HttpClient {
+public:
+    explicit HttpClient(const Options& opt) : opt(opt), stream(ioc) {}
+
+    // Returns the status code; reconnects once if the server closed the connection
+    int post(const std::string& target, const std::string& body, const std::string& bearer, std::string* response_body = nullptr) {
+        return send(http::verb::post, target, body, bearer, response_body);
+    }
+
+    int get(const std::string& target, const std::string& bearer) {
+        return send(http::verb::get, target, "", bearer, nullptr);
+    }
+
+private:
+    const Options& opt;
+    net::io_context ioc;
+    beast::tcp_stream stream;
+    beast::flat_buffer buffer;
+    bool connected = false;
+
+    int send(http::verb method, const std::string& target, const std::string& body, const std::string& bearer, std::string* response_body) {
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            try {
+                if (!connected) connect();
+
+                http::request<http::string_body> req{method, target, 11};
+                req.set(http::field::host, opt.host);
+                req.keep_alive(true);
+                if (!bearer.empty()) {
+                    req.set(http::field::authorization, "Bearer " + bearer);
+                }
+                if (method == http::verb::post) {
+                    req.set(http::field::content_type, "application/json");
+                    req.body() = body;
+                }
+                req.prepare_payload();
+
+                http::write(stream, req);
+
+                http::response<http::string_body> res;
+                http::read(stream, buffer, res);
+
+                if (!res.keep_alive()) close();
+                if (response_body) *response_body = std::move(res.body());
+
+                return res.result_int();
+            } catch (const std::exception&) {
+                close();
+            }
+        }
+        return 0;
+    }
+
+    void connect() {
+        tcp::resolver resolver(ioc);
+        stream.connect(resolver.resolve(opt.host, opt.port));
+        connected = true;
+    }
+
+    void close() {
+        beast::error_code ec;
+        stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+        stream.close();
+        buffer.consume(buffer.size());
+        connected = false;
+    }
+};
+
+static std::string credentials(int user, const Options& opt) {
+    return json{{"username", "bench_" + std::to_string(user)}, {"password", opt.password}}.dump();
+}
+
+// Signs every bench user up (a no-op when it exists) and returns their tokens
+static std::vector<std::string> setup_users(const Options& opt) {
+    HttpClient client(opt);
+    std::vector<std::string> tokens;
+
+    for (int i = 0; i < opt.users; ++i) {
+        json signup = json::parse(credentials(i, opt));
+        signup["displayName"] = "Bench " + std::to_string(i);
+        client.post("/api/create", signup.dump(), "");
+
+        std::string body;
+        client.post("/api/login", credentials(i, opt), "", &body);
+
+        try {
+            tokens.push_back(json::parse(body)["response"].value("token", ""));
+        } catch (const std::exception&) {
+            tokens.emplace_back();
+        }
+
+        if (tokens.back().empty()) {
+            throw std::runtime_error("login failed for bench_" + std::to_string(i) + ": " + body);
+        }
+    }
+
+    return tokens;
+}
+
+// Runs one request shape from `connections` threads for the phase duration
+static Samples run_route(const Options& opt, const std::function<int(HttpClient&, int)>& request) {
+    std::vector<Samples> per_thread(opt.connections);
+    std::vector<std::thread> threads;
+    auto deadline = Clock::now() + std::chrono::seconds(opt.duration);
+
+    for (int t = 0; t < opt.connections; ++t) {
+        threads.emplace_back([&, t] {
+            HttpClient client(opt);
+            Samples& samples = per_thread[t];
+
+            for (int n = 0; Clock::now() < deadline; ++n) {
+                auto start = Clock::now();
+                int status = request(client, t + n * opt.connections);
+
+                if (status == 200) {
+                    samples.us.push_back(elapsed_us(start));
+                } else {
+                    samples.errors++;
+                }
+            }
+        });
+    }
+
+    for (auto& t : threads) t.join();
+
+    Samples all;
+    for (const auto& s : per_thread) all.merge(s);
+    return all;
+}
+
+//------------------------------------------------------------
+// WebSocket fan-out (asynchronous, one strand per client)
+//------------------------------------------------------------
+class WsClient : public std::enable_shared_from_this<WsClient> {
+public:
+    WsClient(net::io_context& ioc, const Options& opt, std::string token)
+        : opt(opt), token(std::move(token)), resolver(net::make_strand(ioc)), ws(resolver.get_executor()), timer(resolver.get_executor()) {}
+
+    Samples samples;          // only touched on the strand until the run ends
+    std::uint64_t sent = 0;
+
+    void start() {
+        resolver.async_resolve(opt.host, opt.port, beast::bind_front_handler(&WsClient::on_resolve, shared_from_this()));
+    }
+
+    void begin_sending(Clock::time_point until) {
+        net::post(ws.get_executor(), [self = shared_from_this(), until] {
+            self->send_until = until;
+            self->schedule();
+        });
+    }
+
+    void stop() {
+        net::post(ws.get_executor(), [self = shared_from_this()] {
+            self->stopping = true;
+            self->timer.cancel();
+
+            // A hard close: a polite close frame could overlap a queued write
+            beast::get_lowest_layer(self->ws).close();
+        });
+    }
+
+private:
+    const Options& opt;
+    std::string token;
+    tcp::resolver resolver;
+    websocket::stream<beast::tcp_stream> ws;
+    net::steady_timer timer;
+    beast::flat_buffer buffer;
+    std::deque<std::shared_ptr<const std::string>> queue;
+    Clock::time_point send_until;
+    bool stopping = false;
+
+    void on_resolve(beast::error_code ec, tcp::resolver::results_type results) {
+        if (ec) return fail(ec);
+        beast::get_lowest_layer(ws).async_connect(results, beast::bind_front_handler(&WsClient::on_connect, shared_from_this()));
+    }
+
+    void on_connect(beast::error_code ec, tcp::resolver::results_type::endpoint_type) {
+        if (ec) return fail(ec);
+
+        beast::get_lowest_layer(ws).expires_never();
+        ws.set_option(websocket::stream_base::decorator([token = token](websocket::request_type& req) {
+            req.set(http::field::authorization, "Bearer " + token);
+        }));
+        ws.async_handshake(opt.host, "/", beast::bind_front_handler(&WsClient::on_handshake, shared_from_this()));
+    }
+
+    void on_handshake(beast::error_code ec) {
+        if (ec) return fail(ec);
+
+        write(json{{"event", "join_server"}, {"data", {{"sid", opt.server}}}}.dump());
+        do_read();
+    }
+
+    void do_read() {
+        ws.async_read(buffer, beast::bind_front_handler(&WsClient::on_read, shared_from_this()));
+    }
+
+    void on_read(beast::error_code ec, std::size_t) {
+        if (ec) {
+            if (!stopping) fail(ec);
+            return;
+        }
+
+        try {
+            json msg = json::parse(beast::buffers_to_string(buffer.data()));
+
+            // Broadcasts carry the sender's send time; clients share one clock
+            if (msg.value("event", "") == "message") {
+                std::string content = msg["data"].value("content", "");
+                if (content.rfind("bench:", 0) == 0) {
+                    Clock::time_point sent_at{Clock::duration(std::stoll(content.substr(6)))};
+                    samples.us.push_back(elapsed_us(sent_at));
+                }
+            } else if (msg.value("event", "") == "error") {
+                samples.errors++;
+            }
+        } catch (const std::exception&) {
+            samples.errors++;
+        }
+
+        buffer.consume(buffer.size());
+        do_read();
+    }
+
+    void schedule() {
+        if (stopping || Clock::now() >= send_until) return;
+
+        timer.expires_after(std::chrono::microseconds(static_cast<long long>(1e6 / opt.rate)));
+        timer.async_wait([self = shared_from_this()](beast::error_code ec) {
+            if (ec || self->stopping) return;
+
+            std::string content = "bench:" + std::to_string(Clock::now().time_since_epoch().count());
+            self->write(json{{"event", "send_message"}, {"data", {{"sid", self->opt.server}, {"message", content}}}}.dump());
+            self->sent++;
+            self->schedule();
+        });
+    }
+
+    void write(std::string payload) {
+        queue.push_back(std::make_shared<const std::string>(std::move(payload)));
+        if (queue.size() == 1) do_write();
+    }
+
+    void do_write() {
+        ws.text(true);
+        ws.async_write(net::buffer(*queue.front()), [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) return self->fail(ec);
+
+            self->queue.pop_front();
+            if (!self->queue.empty()) self->do_write();
+        });
+    }
+
+    void fail(beast::error_code ec) {
+        if (stopping) return;
+        samples.errors++;
+        std::cerr << "[loadgen] WebSocket: " << ec.message() << "\n";
+    }
+};
+
+static Samples run_fanout(const Options& opt, const std::vector<std::string>& tokens, std::uint64_t& sent) {
+    net::io_context ioc;
+    auto guard = net::make_work_guard(ioc);
+
+    std::vector<std::shared_ptr<WsClient>> clients;
+    for (int i = 0; i < opt.ws_clients; ++i) {
+        clients.push_back(std::make_shared<WsClient>(ioc, opt, tokens[i % tokens.size()]));
+        clients.back()->start();
+    }
+
+    std::vector<std::thread> threads;
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < workers; ++i) {
+        threads.emplace_back([&ioc] { ioc.run(); });
+    }
+
+    // Let every client connect and join before anyone sends
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    auto until = Clock::now() + std::chrono::seconds(opt.duration);
+    for (auto& c : clients) c->begin_sending(until);
+
+    // Drain in-flight broadcasts before closing
+    std::this_thread::sleep_until(until + std::chrono::seconds(2));
+    for (auto& c : clients) c->stop();
+
+    guard.reset();
+    for (auto& t : threads) t.join();
+
+    Samples all;
+    sent = 0;
+    for (auto& c : clients) {
+        all.merge(c->samples);
+        sent += c->sent;
+    }
+    return all;
+}
+
+//------------------------------------------------------------
+// Entry point
+//------------------------------------------------------------
+static void usage() {
+    std::cout << "atlas_loadgen [--host H] [--port P] [--server SID] [--password PW]\n"
+                 "              [--users N] [--connections N] [--duration SECONDS]\n"
+                 "              [--ws-clients N] [--rate MSGS_PER_SEC]\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage();
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--host") opt.host = value();
+        else if (arg == "--port") opt.port = value();
+        else if (arg == "--server") opt.server = value();
+        else if (arg == "--password") opt.password = value();
+        else if (arg == "--users") opt.users = std::stoi(value());
+        else if (arg == "--connections") opt.connections = std::stoi(value());
+        else if (arg == "--duration") opt.duration = std::stoi(value());
+        else if (arg == "--ws-clients") opt.ws_clients = std::stoi(value());
+        else if (arg == "--rate") opt.rate = std::stod(value());
+        else {
+            usage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    opt.users = std::max(1, opt.users);
+    opt.connections = std::max(1, opt.connections);
+    opt.duration = std::max(1, opt.duration);
+    opt.rate = std::max(0.1, opt.rate);
+
+    try {
+        std::cout << "Setting up " << opt.users << " users against " << opt.host << ":" << opt.port << "...\n";
+        std::vector<std::string> tokens = setup_users(opt);
+
+        std::cout << opt.connections << " connections, " << opt.duration << "s per route\n\n";
+        print_header();
+
+        print_row("POST /api/login", run_route(opt, [&](HttpClient& client, int n) {
+            return client.post("/api/login", credentials(n % opt.users, opt), "");
+        }), opt.duration);
+
+        std::string history = "/api/servers/" + opt.server + "/messages?limit=50";
+        print_row("GET /api/servers/{sid}/messages", run_route(opt, [&](HttpClient& client, int n) {
+            return client.get(history, tokens[n % tokens.size()]);
+        }), opt.duration);
+
+        print_row("GET /api/servers", run_route(opt, [&](HttpClient& client, int n) {
+            return client.get("/api/servers", tokens[n % tokens.size()]);
+        }), opt.duration);
+
+        if (opt.ws_clients > 0) {
+            std::uint64_t sent = 0;
+            Samples fanout = run_fanout(opt, tokens, sent);
+
+            print_row("ws broadcast receive", fanout, opt.duration);
+            std::printf("\n%llu messages sent by %d clients; each should reach every client\n",
+                        static_cast<unsigned long long>(sent), opt.ws_clients);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[loadgen] " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+-- Scratch database for bench/loadgen. Mirrors the columns atlas_server reads
+-- and writes; point [database] in cenv at it before starting the server.
+--
+--   createdb atlas_bench && psql atlas_bench -f bench/schema.sql
+
+DROP TABLE IF EXISTS server_invites, messages, user_servers, servers, users;
+
+CREATE TABLE users (
+    user_id           TEXT PRIMARY KEY,
+    username          TEXT NOT NULL UNIQUE,
+    displayname       TEXT NOT NULL DEFAULT '',
+    password          TEXT NOT NULL,
+    profile_picture   TEXT NOT NULL DEFAULT '',
+    appearance_status TEXT NOT NULL DEFAULT 'offline',
+    custom_status     TEXT NOT NULL DEFAULT '',
+    bio               TEXT NOT NULL DEFAULT ''
+);
+
+CREATE TABLE servers (
+    server_id   TEXT PRIMARY KEY,
+    server_name TEXT NOT NULL,
+    owner       TEXT NOT NULL
+);
+
+CREATE TABLE user_servers (
+    sid TEXT NOT NULL REFERENCES servers (server_id),
+    uid TEXT NOT NULL REFERENCES users (user_id),
+    PRIMARY KEY (sid, uid)
+);
+
+CREATE TABLE messages (
+    id          SERIAL PRIMARY KEY,
+    user_id     TEXT NOT NULL,
+    server_id   TEXT NOT NULL,
+    content     TEXT NOT NULL,
+    timestamp   TIMESTAMP NOT NULL,
+    message_ref INTEGER,
+    link        TEXT
+);
+
+-- Same index as sql/001_messages_keyset_index.sql
+CREATE INDEX messages_server_id_id_idx ON messages (server_id, id);
+
+CREATE TABLE server_invites (
+    code      TEXT PRIMARY KEY,
+    issued_by TEXT NOT NULL,
+    sid       TEXT NOT NULL REFERENCES servers (server_id)
+);
+
+-- The server every bench client joins; storage_memory.cpp seeds the same row
+INSERT INTO servers (server_id, server_name, owner) VALUES ('bench-server', 'Bench', 'bench');
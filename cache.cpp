@@ -0,0 +1,325 @@
+#include "headers/cache.hpp"
+#include "headers/cenv.hpp"
+#include <algorithm>
+#include <mutex>
+
+ShardedLru<std::string, User>& profile_cache() {
+    static ShardedLru<std::string, User> cache(16, 1024);
+    return cache;
+}
+
+json profile_cache_stats() {
+    auto stats = profile_cache().stats();
+
+    return json{
+        {"hits", stats.hits},
+        {"misses", stats.misses},
+        {"evictions", stats.evictions},
+        {"size", stats.size}
+    };
+}
+
+//------------------------------------------------------------
+// Membership index
+//------------------------------------------------------------
+namespace {
+
+void add_unique(std::vector<std::string>& ids, const std::string& id) {
+    if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
+        ids.push_back(id);
+    }
+}
+
+}
+
+MembershipIndex::MembershipIndex(std::size_t max_users, std::size_t max_servers)
+    : servers(16, std::max<std::size_t>(max_servers / 16, 1)),
+      user_servers(16, std::max<std::size_t>(max_users / 16, 1)),
+      server_members(16, std::max<std::size_t>(max_servers / 16, 1)) {}
+
+// A set whose server metadata has been evicted counts as a miss
+std::optional<std::vector<Server>> MembershipIndex::servers_of(const std::string& user_id) {
+    auto ids = user_servers.get(user_id);
+    if (!ids) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    std::vector<Server> result;
+    result.reserve(ids->size());
+    for (const auto& server_id : *ids) {
+        auto meta = servers.get(server_id);
+        if (!meta) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        result.push_back(std::move(*meta));
+    }
+
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return result;
+}
+
+std::optional<std::vector<std::string>> MembershipIndex::members_of(const std::string& server_id) {
+    auto members = server_members.get(server_id);
+    (members ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+    return members;
+}
+
+std::optional<Server> MembershipIndex::server(const std::string& server_id) {
+    auto server = servers.get(server_id);
+    (server ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+    return server;
+}
+
+void MembershipIndex::load_user(const std::string& user_id, const std::vector<Server>& list) {
+    std::lock_guard<std::mutex> lock(write_mtx);
+
+    std::vector<std::string> ids;
+    ids.reserve(list.size());
+    for (const auto& server : list) {
+        servers.put(server.serverID, server);
+        ids.push_back(server.serverID);
+        server_members.update(server.serverID, [&](std::vector<std::string>& members) {
+            add_unique(members, user_id);
+        });
+    }
+    user_servers.put(user_id, std::move(ids));
+}
+
+void MembershipIndex::load_server(const std::string& server_id, const std::vector<std::string>& members) {
+    std::lock_guard<std::mutex> lock(write_mtx);
+
+    for (const auto& user_id : members) {
+        user_servers.update(user_id, [&](std::vector<std::string>& ids) {
+            add_unique(ids, server_id);
+        });
+    }
+    server_members.put(server_id, members);
+}
+
+void MembershipIndex::put_server(const Server& server) {
+    servers.put(server.serverID, server);
+}
+
+void MembershipIndex::add_member(const std::string& server_id, const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(write_mtx);
+
+    server_members.update(server_id, [&](std::vector<std::string>& members) {
+        add_unique(members, user_id);
+    });
+    user_servers.update(user_id, [&](std::vector<std::string>& ids) {
+        add_unique(ids, server_id);
+    });
+}
+
+json MembershipIndex::stats() {
+    auto server_stats = servers.stats();
+    auto user_stats = user_servers.stats();
+    auto member_stats = server_members.stats();
+
+    return json{
+        {"hits", hits.load(std::memory_order_relaxed)},
+        {"misses", misses.load(std::memory_order_relaxed)},
+        {"servers", server_stats.size},
+        {"loaded_users", user_stats.size},
+        {"loaded_servers", member_stats.size},
+        {"evictions", server_stats.evictions + user_stats.evictions + member_stats.evictions}
+    };
+}
+
+MembershipIndex& membership() {
+    static MembershipIndex index(
+        atlas_cenv().find_number<std::size_t>("cache", "membership_users", 16384),
+        atlas_cenv().find_number<std::size_t>("cache", "membership_servers", 16384)
+    );
+    return index;
+}
+
+//------------------------------------------------------------
+// Recent message ring
+//------------------------------------------------------------
+MessageRing::MessageRing(std::size_t capacity, std::size_t max_servers)
+    : cap(std::max<std::size_t>(capacity, 1)), rings(16, std::max<std::size_t>(max_servers / 16, 1)) {}
+
+MessageRing::Stripe& MessageRing::stripe_for(const std::string& server_id) {
+    return stripes[std::hash<std::string>{}(server_id) % kStripes];
+}
+
+bool MessageRing::latest(const std::string& server_id, int limit, JsonWriter& out) {
+    std::vector<Record> page;
+    bool has_more = false;
+
+    {
+        std::optional<std::shared_ptr<Ring>> found = rings.get(server_id);
+        if (!found) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Ring& ring = **found;
+        std::lock_guard<std::mutex> lock(ring.mtx);
+
+        std::size_t want = static_cast<std::size_t>(std::max(limit, 0));
+        if (ring.records.size() < want && !ring.exhausted) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        std::size_t rows = std::min(want, ring.records.size());
+        page.assign(ring.records.end() - rows, ring.records.end());
+        has_more = ring.records.size() > rows || !ring.exhausted;
+    }
+
+    hits.fetch_add(1, std::memory_order_relaxed);
+
+    out.begin_object();
+    out.key("messages").begin_array();
+
+    for (auto& record : page) {
+        // Current profile wins over the name captured when the message was stored
+        if (auto user = profile_cache().get(record.userID)) {
+            record.displayName = user->displayName;
+            record.picture = user->picture;
+        }
+
+        out.begin_object();
+        out.key("content").value(record.content);
+        out.key("displayName").value(record.displayName);
+        out.key("id").value(record.id);
+        out.key("link").value(record.link);
+        out.key("messageRef").value(record.messageRef);
+        out.key("picture").value(record.picture);
+        out.key("server_id").value(record.serverID);
+        out.key("timestamp").value(record.timestamp);
+        out.end_object();
+    }
+    out.end_array();
+
+    out.key("next_cursor");
+    if (has_more && !page.empty()) {
+        out.value(page.front().id);
+    } else {
+        out.null();
+    }
+
+    out.key("success").value(true);
+    out.end_object();
+
+    return true;
+}
+
+std::uint64_t MessageRing::version(const std::string& server_id) {
+    Stripe& stripe = stripe_for(server_id);
+    std::lock_guard<std::mutex> lock(stripe.mtx);
+    return stripe.version;
+}
+
+void MessageRing::seed(const std::string& server_id, std::uint64_t version, std::vector<Record> records, bool exhausted) {
+    std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+        return a.id < b.id;
+    });
+
+    // Keep the newest cap records
+    auto ring = std::make_shared<Ring>();
+    std::size_t drop = records.size() > cap ? records.size() - cap : 0;
+    ring->records.assign(std::make_move_iterator(records.begin() + drop), std::make_move_iterator(records.end()));
+    ring->exhausted = exhausted && drop == 0;
+
+    Stripe& stripe = stripe_for(server_id);
+    std::lock_guard<std::mutex> lock(stripe.mtx);
+
+    // Seeds only follow a latest() miss, so a ring already here is one that
+    // erase() has shrunk below a page; an unchanged version means this
+    // snapshot is at least as current, so it replaces it
+    if (stripe.version != version) return;
+    rings.put(server_id, std::move(ring));
+}
+
+void MessageRing::push(Record record) {
+    Stripe& stripe = stripe_for(record.serverID);
+    std::lock_guard<std::mutex> stripe_lock(stripe.mtx);
+
+    stripe.version++;
+
+    auto found = rings.get(record.serverID);
+    if (!found) return;
+
+    Ring& ring = **found;
+    std::lock_guard<std::mutex> lock(ring.mtx);
+
+    // Commits can land out of id order across threads; insert from the back
+    auto it = ring.records.end();
+    while (it != ring.records.begin() && std::prev(it)->id > record.id) --it;
+    ring.records.insert(it, std::move(record));
+
+    if (ring.records.size() > cap) {
+        ring.records.pop_front();
+        ring.exhausted = false;
+    }
+}
+
+void MessageRing::edit(const std::string& server_id, int message_id, const std::string& content) {
+    Stripe& stripe = stripe_for(server_id);
+    std::lock_guard<std::mutex> stripe_lock(stripe.mtx);
+
+    stripe.version++;
+
+    auto found = rings.get(server_id);
+    if (!found) return;
+
+    Ring& ring = **found;
+    std::lock_guard<std::mutex> lock(ring.mtx);
+
+    for (auto& record : ring.records) {
+        if (record.id == message_id) {
+            record.content = content;
+            break;
+        }
+    }
+}
+
+void MessageRing::erase(const std::string& server_id, int message_id) {
+    Stripe& stripe = stripe_for(server_id);
+    std::lock_guard<std::mutex> stripe_lock(stripe.mtx);
+
+    stripe.version++;
+
+    auto found = rings.get(server_id);
+    if (!found) return;
+
+    Ring& ring = **found;
+    std::lock_guard<std::mutex> lock(ring.mtx);
+
+    auto it = std::find_if(ring.records.begin(), ring.records.end(), [&](const Record& record) {
+        return record.id == message_id;
+    });
+    if (it != ring.records.end()) {
+        ring.records.erase(it);
+    }
+}
+
+json MessageRing::stats() {
+    auto lru = rings.stats();
+
+    return json{
+        {"hits", hits.load(std::memory_order_relaxed)},
+        {"misses", misses.load(std::memory_order_relaxed)},
+        {"capacity", cap},
+        {"servers", lru.size},
+        {"evictions", lru.evictions}
+    };
+}
+
+MessageRing& message_ring() {
+    static MessageRing ring = [] {
+        auto& cenv = atlas_cenv();
+
+        return MessageRing(
+            cenv.find_number<std::size_t>("cache", "message_ring", 100),
+            cenv.find_number<std::size_t>("cache", "message_ring_servers", 4096)
+        );
+    }();
+
+    return ring;
+}
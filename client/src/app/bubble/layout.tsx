@@ -80,13 +80,11 @@ export default function RootLayout({
         async function get_servers() {
             const token = get_token();
             
-            const res = await fetch(construct_path("api/servers/get"), {
-                method: "POST",
+            const res = await fetch(construct_path("api/servers"), {
+                method: "GET",
                 headers: {
-                    "Content-Type": "application/json",
                     "Authorization": `Bearer ${token}`
                 },
-                body: JSON.stringify({ }), 
             });
             const data = await res.json();
 
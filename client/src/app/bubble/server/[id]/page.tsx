@@ -39,12 +39,8 @@ export default function Chat({ params }: { params: Promise<{ id: string }> }) {
 
     useEffect(() => {
         async function load_chat() {
-            const res = await fetch(construct_path("api/messages_get"), {
-                method: "POST",
-                headers: {
-                    "Content-Type": "application/json"
-                },
-                body: JSON.stringify({ "sid": sid }),
+            const res = await fetch(construct_path(`api/servers/${encodeURIComponent(sid)}/messages`), {
+                method: "GET",
             });
             const data = await res.json();
             const messages: messageFormat[] = data.messages.messages;
@@ -262,12 +258,8 @@ export default function Chat({ params }: { params: Promise<{ id: string }> }) {
 
     useEffect(() => {
         async function get_userlist() {    
-            const res = await fetch(construct_path("api/servers/userlist_get"), {
-                method: "POST",
-                headers: {
-                    "Content-Type": "application/json"
-                },
-                body: JSON.stringify({ "serverID": sid }),
+            const res = await fetch(construct_path(`api/servers/${encodeURIComponent(sid)}/users`), {
+                method: "GET",
             });
             
             const data = await res.json();
@@ -41,13 +41,11 @@ export default function SettingsPage() {
         async function getUserData() {
             const token = get_token();
 
-            const res = await fetch(construct_path("api/account/get"), {
-                method: "POST",
+            const res = await fetch(construct_path("api/account"), {
+                method: "GET",
                 headers: {
-                    "Content-Type": "application/json",
                     "Authorization": `Bearer ${token}`
                 },
-                body: JSON.stringify({  })
             });
             const data = await res.json();
             setUser(data.user);
@@ -1,4 +1,5 @@
 import { globals } from "./env";
+import { get_token } from "./user";
 
 let ws: WebSocket | null = null;
 
@@ -7,6 +8,12 @@ export function getWebSocket(): WebSocket {
     ws = new WebSocket(`ws://${globals.url_string.subdomain}:8080`);
 
     ws.onopen = () => console.log("[WebSocket] Connected");
+
+    // The server binds this socket to the user once; pages may replace onopen
+    const socket = ws;
+    socket.addEventListener("open", () => {
+      socket.send(JSON.stringify({ event: "auth", data: { token: get_token() } }));
+    });
     ws.onclose = () => console.log("[WebSocket] Disconnected");
     ws.onerror = (err) => console.error("[WebSocket] Error:", err);
   }
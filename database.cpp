@@ -1,24 +1,159 @@
-#include <iostream>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include "headers/database.hpp"
+#include "headers/statements.hpp"
+#include "headers/storage.hpp"
+#include "headers/hashing.hpp"
+#include "headers/cache.hpp"
+#include "headers/log.hpp"
 #include <cstddef>
 #include <nlohmann/json.hpp>
 #include "headers/abstract.hpp"
 #include <argon2.h>
 #include <random>
+#include <chrono>
 #include <string>
 
 using json = nlohmann::json;
 
-Database::Database(const std::string& conn_str) : conn(conn_str) {}
 struct User;
 
-pqxx::connection& Database::getConnection() {
+//------------------------------------------------------------
+// Connection pool
+//------------------------------------------------------------
+Database::Connection::Connection(Database* pool, std::unique_ptr<pqxx::connection> conn)
+    : pool(pool), conn(std::move(conn)) {}
+
+Database::Connection::Connection(Connection&& other) noexcept
+    : pool(other.pool), conn(std::move(other.conn)) {
+    other.pool = nullptr;
+}
+
+Database::Connection::~Connection() {
+    if (pool && conn) {
+        pool->release(std::move(conn));
+    }
+}
+
+pqxx::connection& Database::Connection::getConnection() {
+    return *conn;
+}
+
+Database::Database(const std::string& conn_str, PoolOptions options)
+    : conn_str(conn_str), options(options) {
+    auto now = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < options.min_size && i < options.max_size; ++i) {
+        idle.push_back({open_connection(), now});
+        ++open;
+    }
+}
+
+std::unique_ptr<pqxx::connection> Database::open_connection() {
+    auto conn = std::make_unique<pqxx::connection>(conn_str);
+    prepare_statements(*conn);
     return conn;
 }
 
+bool Database::healthy(Idle& entry) {
+    if (!entry.conn->is_open()) {
+        return false;
+    }
+
+    // Recently returned connections are trusted; older ones may have been dropped by the server
+    if (std::chrono::steady_clock::now() - entry.since < options.idle_check) {
+        return true;
+    }
+
+    try {
+        pqxx::nontransaction txn(*entry.conn);
+        txn.exec("SELECT 1");
+        return true;
+    } catch (const std::exception& e) {
+        LOG_WARN("dropping stale db connection", {"error", e.what()});
+        return false;
+    }
+}
+
+Database::Connection Database::acquire() {
+    std::unique_lock<std::mutex> lock(mtx);
+    auto deadline = std::chrono::steady_clock::now() + options.wait_timeout;
+
+    for (;;) {
+        // Reuse the most recently returned connection first
+        while (!idle.empty()) {
+            Idle entry = std::move(idle.back());
+            idle.pop_back();
+
+            lock.unlock();
+            if (healthy(entry)) {
+                return Connection(this, std::move(entry.conn));
+            }
+            entry.conn.reset();
+            lock.lock();
+            --open;
+        }
+
+        if (open < options.max_size) {
+            ++open;
+            lock.unlock();
+
+            try {
+                return Connection(this, open_connection());
+            } catch (...) {
+                lock.lock();
+                --open;
+                available.notify_one();
+                throw;
+            }
+        }
+
+        if (available.wait_until(lock, deadline) == std::cv_status::timeout && idle.empty() && open >= options.max_size) {
+            throw std::runtime_error(
+                "Database pool exhausted: all " + std::to_string(options.max_size) +
+                " connections busy for " + std::to_string(options.wait_timeout.count()) + "ms"
+            );
+        }
+    }
+}
+
+void Database::release(std::unique_ptr<pqxx::connection> conn) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (conn->is_open()) {
+            idle.push_back({std::move(conn), std::chrono::steady_clock::now()});
+        } else {
+            --open;
+        }
+    }
+
+    available.notify_one();
+}
+
+Database& database() {
+    static Database pool = [] {
+        auto& cenv = atlas_cenv();
+
+        std::string dbname = cenv.find_token("database", "dbname");
+        std::string user = cenv.find_token("database", "user");
+        std::string password = cenv.find_token("database", "password");
+        std::string host = cenv.find_token("database", "host");
+
+        std::string conn_str = "dbname=" + dbname + " user=" + user + " password=" + password + " host=" + host;
+
+        Database::PoolOptions options;
+        options.min_size = cenv.find_number("database", "pool_min", options.min_size);
+        options.max_size = cenv.find_number("database", "pool_max", options.max_size);
+        options.wait_timeout = std::chrono::milliseconds(cenv.find_number("database", "pool_wait_ms", options.wait_timeout.count()));
+
+        return Database(conn_str, options);
+    }();
+
+    return pool;
+}
+
 std::string generateSalt(size_t length = 16) {
     static const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
     std::string salt;
@@ -35,6 +170,7 @@ std::string hashPassword(const std::string& password) {
 
     std::string salt = generateSalt();
 
+    auto started = std::chrono::steady_clock::now();
     int result = argon2id_hash_encoded(
         2,
         1 << 16,
@@ -47,6 +183,7 @@ std::string hashPassword(const std::string& password) {
         hash,
         static_cast<size_t>(sizeof(hash))
     );
+    hash_pool().record_hash(std::chrono::steady_clock::now() - started);
 
     if (result != ARGON2_OK) {
         throw std::runtime_error(argon2_error_message(result));
@@ -57,21 +194,9 @@ std::string hashPassword(const std::string& password) {
 
 bool user_exists(const std::string& username) {
     try {
-        // Connect to the database
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        // Start a transaction
-        pqxx::work txn(conn);
-
-        // Query for the username
-        pqxx::result r = txn.exec("SELECT 1 FROM users WHERE username = " + txn.quote(username) + " LIMIT 1");
-
-        // If the result has any rows, user exists
-        return !r.empty();
-
+        return storage().user_exists(username);
     } catch (const std::exception &e) {
-        std::cerr << "Error checking user: " << e.what() << "\n";
+        LOG_ERROR("user_exists failed", {"user", username}, {"error", e.what()});
         return false;
     }
 }
@@ -89,105 +214,95 @@ void create_account(
     std::string appearance_status = "offline";
 
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
         if (user_exists(username)) {
             return;
         }
 
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec(
-            "INSERT INTO users (username, displayname, password, user_id, appearance_status, custom_status, bio) VALUES (" 
-                + txn.quote(username) + ", " 
-                + txn.quote(displayName) + ", " 
-                + txn.quote(passwrd_hash) + ", " 
-                + txn.quote(user_id) + ", "
-                + txn.quote(appearance_status) + ", "
-                + txn.quote(custom_status) + ", "
-                + txn.quote(bio) +
-            ")"
-        );
-
-        txn.commit();
+        User user {
+            .username = username,
+            .userid = user_id,
+            .displayName = displayName,
+            .status = appearance_status,
+            .picture = "",
+            .customStatus = custom_status,
+            .bio = bio
+        };
+
+        storage().create_user(user, passwrd_hash);
     } catch (std::exception &e) {
-        std::cerr << e.what() << "\n";
+        LOG_ERROR("create_account failed", {"user", username}, {"error", e.what()});
     }
 }
 
 void update_account(const std::string& username, const std::string& displayname, const std::string& profile_picture, const std::string& custom_status, const std::string& bio, const std::string& UUID) {
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec_params("UPDATE users SET username = $1, displayname = $2, profile_picture = $3, custom_status = $4, bio = $5 WHERE user_id = $6", username, displayname, profile_picture, custom_status, bio, UUID);
-
-        txn.commit();
-
-        std::cout << "Account updated" << "\n";
+        storage().update_user(User{
+            .username = username,
+            .userid = UUID,
+            .displayName = displayname,
+            .status = "", // ignored: update_user never touches status
+            .picture = profile_picture,
+            .customStatus = custom_status,
+            .bio = bio
+        });
+
+        profile_cache().update(UUID, [&](User& user) {
+            user.username = username;
+            user.displayName = displayname;
+            user.picture = profile_picture;
+            user.customStatus = custom_status;
+            user.bio = bio;
+        });
+
+        LOG_DEBUG("account updated", {"user", UUID});
 
     } catch (std::exception &e) {
-        std::cout << e.what() << "\n";
+        LOG_ERROR("update_account failed", {"user", UUID}, {"error", e.what()});
     }
 }
 
 bool login_user(std::string& username, std::string& password) {
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec("SELECT password FROM users WHERE username = " + txn.quote(username) + " LIMIT 1");
+        std::optional<std::string> uPassword = storage().password_hash(username);
 
-        if (r.empty()) {
-            std::cout << "User not found";
+        if (!uPassword) {
+            LOG_DEBUG("login for unknown user", {"user", username});
             return false;
         }
 
-        std::string uPassword = r[0]["password"].c_str();
+        auto started = std::chrono::steady_clock::now();
+        int verified = argon2id_verify(uPassword->c_str(), password.c_str(), password.size());
+        hash_pool().record_hash(std::chrono::steady_clock::now() - started);
 
-        if (argon2id_verify(uPassword.c_str(), password.c_str(), password.size()) == ARGON2_OK) {
-            std::cout << "Login successful!\n";
+        if (verified == ARGON2_OK) {
+            LOG_DEBUG("login succeeded", {"user", username});
             return true;
         } else {
-            std::cout << "Incorrect password!\n";
+            LOG_WARN("login with incorrect password", {"user", username});
             return false;
         }
     } catch (std::exception &e) {
-        std::cerr << e.what() << "\n";
-        return json{
-            {"error", e.what()}
-        };
+        LOG_ERROR("login_user failed", {"user", username}, {"error", e.what()});
+        return false;
     }
 }
 
 json get_user(const std::string& username) {
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec("SELECT * FROM users WHERE username = " + txn.quote(username));
+        std::optional<User> user = storage().user_by_name(username);
 
-        if (r.empty()) {
-            std::cout << "User not found";
+        if (!user) {
+            LOG_DEBUG("user not found", {"user", username});
             return json{{"status", "failed"}};
-        } else {
-            std::string displayname = r[0]["displayname"].c_str();
-            std::string user = r[0]["username"].c_str();
-            std::string user_id = r[0]["user_id"].c_str();
-
-            return json{
-                {"username", user},
-                {"displayname", displayname},
-                {"user_id", user_id}
-            };
         }
 
-        txn.commit();
+        return json{
+            {"username", user->username},
+            {"displayname", user->displayName},
+            {"user_id", user->userid}
+        };
     } catch (const std::exception &e) {
-        std::cerr << e.what() << "\n";
+        LOG_ERROR("get_user failed", {"user", username}, {"error", e.what()});
         return json{
             {"error", e.what()}
         };
@@ -195,37 +310,33 @@ json get_user(const std::string& username) {
 }
 
 json get_user_all(const std::string& UUID) {
-    try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
+    auto to_json = [](const User& user) {
+        return json{
+            {"username", user.username},
+            {"userid", user.userid},
+            {"displayName", user.displayName},
+            {"picture", user.picture},
+            {"customStatus", user.customStatus},
+            {"bio", user.bio}
+        };
+    };
 
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec_params("SELECT * FROM users WHERE user_id = $1 ", UUID);
+    if (auto cached = profile_cache().get(UUID)) {
+        return to_json(*cached);
+    }
 
-        if (r.empty()) {
-            std::cout << "User not found";
+    try {
+        std::optional<User> user = storage().user_by_id(UUID);
+
+        if (!user) {
+            LOG_DEBUG("user not found", {"user", UUID});
             return json{{"status", "failed"}};
-        } else {
-            std::string displayname = r[0]["displayname"].c_str();
-            std::string username = r[0]["username"].c_str();
-            std::string user_id = r[0]["user_id"].c_str();
-            std::string pfp = r[0]["profile_picture"].c_str();
-            std::string custom_status = r[0]["custom_status"].c_str();
-            std::string bio = r[0]["bio"].c_str();
-
-            return json{
-                {"username", username},
-                {"userid", user_id},
-                {"displayName", displayname},
-                {"picture", pfp},
-                {"customStatus", custom_status},
-                {"bio", bio}
-            };
         }
 
-        txn.commit();
+        profile_cache().put(UUID, *user);
+        return to_json(*user);
     } catch (const std::exception &e) {
-        std::cerr << e.what() << "\n";
+        LOG_ERROR("get_user_all failed", {"user", UUID}, {"error", e.what()});
         return json{
             {"what", e.what()}
         };
@@ -235,52 +346,31 @@ json get_user_all(const std::string& UUID) {
 json user_get_all_servers(const std::string& UUID) {
     json response;
 
-    try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec_params(
-            "SELECT s.server_id, s.server_name, s.owner "
-            "FROM servers s "
-            "JOIN user_servers us ON s.server_id = us.sid "
-            "WHERE us.uid = $1",
-            UUID
-        );
-
-        for (auto row : r) {
-            std::string serverId = row["server_id"].as<std::string>();
-            std::string serverName = row["server_name"].c_str();  // or row["name"].as<std::string>()
-            std::string owner = row["owner"].c_str();
+    auto to_response = [&](const std::vector<Server>& servers) {
+        for (const auto& server : servers) {
             response["server"].push_back({
-                {"name", serverName},
-                {"serverID", serverId},
-                {"owner", owner}
+                {"name", server.name},
+                {"serverID", server.serverID},
+                {"owner", server.owner}
             });
         }
-        
-        txn.commit();
+    };
+
+    if (auto cached = membership().servers_of(UUID)) {
+        to_response(*cached);
+        return response;
+    }
+
+    try {
+        std::vector<Server> servers = storage().servers_of(UUID);
+
+        membership().load_user(UUID, servers);
+        to_response(servers);
     } catch (std::exception &e) {
         response["error"] = 404;
         response["what"] = e.what();
-        std::cout << e.what() << "\n";
+        LOG_ERROR("user_get_all_servers failed", {"user", UUID}, {"error", e.what()});
     }
 
     return response;
 }
-
-std::string set_user_appearance_status(const std::string& UUID, const std::string& status) {
-    try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec_params("UPDATE users SET appearance_status = $1 WHERE user_id = $2 RETURNING appearance_status;", status, UUID);
-
-        
-        txn.commit();
-        return r[0]["appearance_status"].as<std::string>();
-    } catch (std::exception &e) {
-        std::cout << e.what() << "\n";
-        return "";
-    }
-}
\ No newline at end of file
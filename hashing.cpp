@@ -0,0 +1,113 @@
+#include "headers/hashing.hpp"
+#include "headers/cenv.hpp"
+#include "headers/log.hpp"
+#include <algorithm>
+#include <exception>
+#include <string>
+
+HashPool::HashPool(std::size_t workers, std::size_t max_queue) : max_queue(max_queue) {
+    for (std::size_t i = 0; i < workers; ++i) {
+        threads.emplace_back(&HashPool::work, this);
+    }
+}
+
+HashPool::~HashPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    ready.notify_all();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+bool HashPool::try_submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (queue.size() >= max_queue) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        queue.push_back(std::move(task));
+        queue_peak = std::max(queue_peak, queue.size());
+    }
+
+    ready.notify_one();
+    return true;
+}
+
+void HashPool::work() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+
+            if (stopping && queue.empty()) return;
+
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("hash task failed", {"error", e.what()});
+        }
+        completed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void HashPool::record_hash(std::chrono::steady_clock::duration elapsed) {
+    auto ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+    hashes.fetch_add(1, std::memory_order_relaxed);
+    hash_ns_total.fetch_add(ns, std::memory_order_relaxed);
+
+    std::uint64_t seen = hash_ns_max.load(std::memory_order_relaxed);
+    while (ns > seen && !hash_ns_max.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {}
+}
+
+json HashPool::stats() const {
+    std::size_t depth;
+    std::size_t peak;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        depth = queue.size();
+        peak = queue_peak;
+    }
+
+    std::uint64_t count = hashes.load(std::memory_order_relaxed);
+    double total_ms = hash_ns_total.load(std::memory_order_relaxed) / 1e6;
+
+    return json{
+        {"workers", threads.size()},
+        {"queue_limit", max_queue},
+        {"queue_depth", depth},
+        {"queue_peak", peak},
+        {"rejected", rejected.load(std::memory_order_relaxed)},
+        {"completed", completed.load(std::memory_order_relaxed)},
+        {"hashes", count},
+        {"hash_avg_ms", count ? total_ms / count : 0.0},
+        {"hash_max_ms", hash_ns_max.load(std::memory_order_relaxed) / 1e6}
+    };
+}
+
+HashPool& hash_pool() {
+    static HashPool pool = [] {
+        auto& cenv = atlas_cenv();
+
+        // One in-flight hash per 64 MiB of budget, never more than there are cores
+        std::size_t budget = cenv.find_number<std::size_t>("argon2", "memory_budget_mb", 512) * 1024 * 1024;
+        std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        std::size_t workers = std::clamp<std::size_t>(budget / kArgon2MemoryBytes, 1, cores);
+
+        return HashPool(workers, cenv.find_number<std::size_t>("argon2", "queue_size", 64));
+    }();
+
+    return pool;
+}
@@ -1,3 +1,4 @@
+#pragma once
 #include <string>
 #include <optional>
 
@@ -8,6 +9,13 @@ struct User {
     std::string status;
     std::string picture;
     std::string customStatus;
+    std::string bio;
+};
+
+struct Server {
+    std::string serverID;
+    std::string name;
+    std::string owner;
 };
 
 struct MessageFormat {
@@ -19,4 +27,18 @@ struct MessageFormat {
     std::string timestamp;
     std::optional<int> messageRef;
     std::optional<std::string> link;
+    std::string userID;
+};
+
+struct Invite {
+    std::string code;
+    std::string issuedBy;
+    std::string serverID;
+};
+
+// Keyset page request for message history. With neither id set the newest page is returned.
+struct MessageCursor {
+    std::optional<int> before; // messages with id < before (older history)
+    std::optional<int> after;  // messages with id > after (catching up)
+    int limit = 50;
 };
\ No newline at end of file
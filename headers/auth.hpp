@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// HS256 signing key from the [secrets] section of the current cenv snapshot,
+// so a rotated key takes effect without a restart
+std::string jwt_secret();
+
+// Verifies the token and returns its subject (the user id). Verified tokens
+// are cached by digest until they expire, so repeat calls skip decoding and
+// the HMAC check. Throws if the token is malformed, forged or expired.
+std::string decode_token(const std::string& token);
+
+// Hit/miss/eviction counters for the verified-token cache
+json token_cache_stats();
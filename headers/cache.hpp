@@ -0,0 +1,124 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "abstract.hpp"
+#include "json_writer.hpp"
+#include "lru.hpp"
+
+using json = nlohmann::json;
+
+// user_id → User. Filled on read, updated in place by the account write paths.
+ShardedLru<std::string, User>& profile_cache();
+
+// Bidirectional user ↔ server membership plus server metadata. A user's or
+// server's set is only answered from memory once it has been loaded whole;
+// join/create keep loaded sets current. Each side is an LRU of its own, so a
+// set or server evicted from one is simply loaded again on the next miss.
+class MembershipIndex {
+public:
+    MembershipIndex(std::size_t max_users, std::size_t max_servers);
+
+    std::optional<std::vector<Server>> servers_of(const std::string& user_id);
+    std::optional<std::vector<std::string>> members_of(const std::string& server_id);
+    std::optional<Server> server(const std::string& server_id);
+
+    void load_user(const std::string& user_id, const std::vector<Server>& servers);
+    void load_server(const std::string& server_id, const std::vector<std::string>& members);
+    void put_server(const Server& server);
+    void add_member(const std::string& server_id, const std::string& user_id);
+
+    json stats();
+
+private:
+    // Keeps multi-entry writes from interleaving; lookups only take shard locks
+    std::mutex write_mtx;
+
+    ShardedLru<std::string, Server> servers;
+    ShardedLru<std::string, std::vector<std::string>> user_servers;   // whole sets only
+    ShardedLru<std::string, std::vector<std::string>> server_members; // whole sets only
+
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+};
+
+MembershipIndex& membership();
+
+// Most recent messages per server, kept in id order and rendered on read so
+// author names and pictures follow the profile cache. A ring exists only once
+// it has been seeded from the database for a server that exists; writes keep
+// it current after. At most max_servers rings are kept, least recently used
+// evicted first.
+class MessageRing {
+public:
+    struct Record {
+        int id;
+        std::string serverID;
+        std::string userID;
+        std::string displayName; // as of insert; overridden by the profile cache
+        std::string picture;
+        std::string content;
+        std::string timestamp;   // already formatted for display
+        std::optional<int> messageRef;
+        std::optional<std::string> link;
+    };
+
+    MessageRing(std::size_t capacity, std::size_t max_servers);
+
+    std::size_t capacity() const { return cap; }
+
+    // Writes the latest page in the same shape as get_messages and returns true,
+    // or writes nothing and returns false if the server's ring is not seeded or
+    // cannot fill the page on its own.
+    bool latest(const std::string& server_id, int limit, JsonWriter& out);
+
+    // Seeding races with concurrent writes: take a version before querying and
+    // seed() is dropped if any write touched the server in between.
+    std::uint64_t version(const std::string& server_id);
+    void seed(const std::string& server_id, std::uint64_t version, std::vector<Record> records, bool exhausted);
+
+    void push(Record record);
+    void edit(const std::string& server_id, int message_id, const std::string& content);
+    void erase(const std::string& server_id, int message_id);
+
+    json stats();
+
+private:
+    struct Ring {
+        std::mutex mtx;
+        std::deque<Record> records;    // ascending id
+        bool exhausted = false;        // nothing older than records.front() exists
+    };
+
+    // Write versions live in a fixed set of stripes rather than per ring, so
+    // reads of unknown servers allocate nothing. A stripe's lock orders seeds
+    // against writes for every server hashed to it.
+    struct Stripe {
+        std::mutex mtx;
+        std::uint64_t version = 0;
+    };
+    static constexpr std::size_t kStripes = 256;
+
+    std::size_t cap;
+
+    ShardedLru<std::string, std::shared_ptr<Ring>> rings;
+    std::array<Stripe, kStripes> stripes;
+
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+
+    Stripe& stripe_for(const std::string& server_id);
+};
+
+MessageRing& message_ring();
+
+// Profile cache counters, for /api/stats
+json profile_cache_stats();
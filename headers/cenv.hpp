@@ -1,70 +1,181 @@
 #pragma once
 #include <string>
+#include <charconv>
 #include <fstream>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 struct cenvxx {
-    struct PostInit {
+    // Immutable parsed view of one cenv file: header → key → value
+    struct Snapshot {
+        bool loaded = false;
+        std::unordered_map<std::string, std::unordered_map<std::string, std::string>> sections;
+    };
+
+    static std::string trim(const std::string& str) {
+        size_t start = str.find_first_not_of(" \t");
+        size_t end   = str.find_last_not_of(" \t");
+
+        if (start == std::string::npos) return "";
+        return str.substr(start, end - start + 1);
+    }
+
+    static std::shared_ptr<const Snapshot> parse(const std::string& directory) {
+        auto snapshot = std::make_shared<Snapshot>();
+
+        std::ifstream env(directory);
+        if (!env.is_open()) {
+            return snapshot;
+        }
+        snapshot->loaded = true;
+
+        std::string line;
+        std::unordered_map<std::string, std::string>* section = nullptr;
+
+        while (std::getline(env, line)) {
+            size_t open = line.find('%');
+
+            // "% header %" starts a new block; a repeated header keeps its first block
+            if (open != std::string::npos) {
+                size_t close = line.find('%', open + 1);
+                std::string header = trim(line.substr(open + 1, close == std::string::npos ? std::string::npos : close - open - 1));
+
+                auto [it, inserted] = snapshot->sections.try_emplace(header);
+                section = inserted ? &it->second : nullptr;
+                continue;
+            }
+
+            size_t pipe_pos = line.find('|');
+            if (!section || pipe_pos == std::string::npos) continue;
+
+            // First occurrence of a key wins, as with the old line scan
+            section->try_emplace(trim(line.substr(0, pipe_pos)), trim(line.substr(pipe_pos + 1)));
+        }
+
+        return snapshot;
+    }
+
+    // Current snapshot of one file, swapped in place by a watcher thread when the file changes
+    struct Source {
         std::string directory;
-        
-        PostInit(const std::string& dir) : directory(dir) {}
-        
-        std::string trim(const std::string& str) {
-            size_t start = str.find_first_not_of(" \t");
-            size_t end   = str.find_last_not_of(" \t");
-        
-            if (start == std::string::npos) return "";
-            return str.substr(start, end - start + 1);
+#if defined(__cpp_lib_atomic_shared_ptr)
+        std::atomic<std::shared_ptr<const Snapshot>> current;
+#else
+        std::mutex mtx;
+        std::shared_ptr<const Snapshot> current;
+#endif
+
+        explicit Source(const std::string& dir) : directory(dir), current(parse(dir)) {}
+
+        std::shared_ptr<const Snapshot> load() {
+#if defined(__cpp_lib_atomic_shared_ptr)
+            return current.load(std::memory_order_acquire);
+#else
+            std::lock_guard<std::mutex> lock(mtx);
+            return current;
+#endif
         }
-        
-        bool line_contains_key(const std::string& line, const std::string& key_to_find) {
-            size_t pos = line.find('|');
-            if (pos == std::string::npos) return false;
-        
-            std::string key = trim(line.substr(0, pos));
-            return key == key_to_find;
+
+        void store(std::shared_ptr<const Snapshot> snapshot) {
+#if defined(__cpp_lib_atomic_shared_ptr)
+            current.store(std::move(snapshot), std::memory_order_release);
+#else
+            std::lock_guard<std::mutex> lock(mtx);
+            current = std::move(snapshot);
+#endif
         }
-        
-        bool is_header(const std::string& line, const std::string& header) {
-            std::string pattern = "% " + header + " %";
-            return line.find(pattern) != std::string::npos;
+
+        // Polls the modification time; portable to the macOS build, unlike inotify
+        void watch() {
+            std::thread([this] {
+                std::error_code ec;
+                auto last = std::filesystem::last_write_time(directory, ec);
+
+                for (;;) {
+                    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+                    auto now = std::filesystem::last_write_time(directory, ec);
+                    if (ec || now == last) continue;
+                    last = now;
+
+                    auto snapshot = parse(directory);
+                    if (snapshot->loaded) {
+                        store(std::move(snapshot));
+                    }
+                }
+            }).detach();
         }
-        
+    };
+
+    // One Source per path for the life of the process (never destroyed; watchers outlive main)
+    static Source& source(const std::string& directory) {
+        static std::mutex registry_mtx;
+        static auto* registry = new std::unordered_map<std::string, std::unique_ptr<Source>>();
+
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        auto& entry = (*registry)[directory];
+        if (!entry) {
+            entry = std::make_unique<Source>(directory);
+            entry->watch();
+        }
+        return *entry;
+    }
+
+    struct PostInit {
+        std::string directory;
+        Source* src;
+
+        PostInit(const std::string& dir) : directory(dir), src(&source(dir)) {}
+
+        std::shared_ptr<const Snapshot> snapshot() const {
+            return src->load();
+        }
+
         std::string find_token(const std::string& header, const std::string& token) {
-            std::ifstream env(directory);
-            if (!env.is_open()) {
+            auto env = snapshot();
+            if (!env->loaded) {
                 return "Failed to open cenv file";
             }
-        
-            std::string line;
-            bool inside_target_header = false;
-        
-            while (std::getline(env, line)) {
-        
-                // Enter header
-                if (is_header(line, header)) {
-                    inside_target_header = true;
-                    continue;
-                }
-        
-                // Stop if we enter a *different* header
-                if (inside_target_header && line.find("%") != std::string::npos) {
-                    // another header begins
-                    break;
-                }
-        
-                // Only search for key if we’re inside the header block
-                if (inside_target_header && line_contains_key(line, token)) {
-                    size_t pipe_pos = line.find('|');
-                    std::string value = trim(line.substr(pipe_pos + 1));
-                    return value;
-                }
+
+            auto section = env->sections.find(header);
+            if (section == env->sections.end()) {
+                return "No key found";
+            }
+
+            auto value = section->second.find(token);
+            if (value == section->second.end()) {
+                return "No key found";
             }
-        
-            return "No key found";
+
+            return value->second;
+        }
+
+        // Whole-number token, or fallback when it is missing or does not parse
+        template <typename T>
+        T find_number(const std::string& header, const std::string& token, T fallback) {
+            std::string value = find_token(header, token);
+
+            T number{};
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+            if (ec != std::errc() || end != value.data() + value.size()) {
+                return fallback;
+            }
+            return number;
         }
     };
 
     PostInit init(const std::string& directory) {
         return PostInit(directory);
     }
-};
\ No newline at end of file
+};
+
+// The server's own settings file
+inline cenvxx::PostInit& atlas_cenv() {
+    static cenvxx::PostInit cenv("../secrets/cenv");
+    return cenv;
+}
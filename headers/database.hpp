@@ -1,26 +1,67 @@
+#pragma once
 #include <pqxx/pqxx>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include "cenv.hpp"
 
+// Bounded pool of long-lived connections. Data functions check a connection
+// out through connect_db() and it returns to the pool when the handle dies.
 class Database {
 public:
-    Database(const std::string& conn_str);
-    pqxx::connection& getConnection();
+    struct PoolOptions {
+        std::size_t min_size = 2;                         // opened eagerly at startup
+        std::size_t max_size = 16;                        // hard cap on open connections
+        std::chrono::milliseconds wait_timeout{2000};     // how long acquire() waits when saturated
+        std::chrono::seconds idle_check{30};              // idle longer than this → ping before reuse
+    };
+
+    // RAII checkout handle
+    class Connection {
+    public:
+        Connection(Connection&& other) noexcept;
+        Connection& operator=(Connection&&) = delete;
+        ~Connection();
+
+        pqxx::connection& getConnection();
+
+    private:
+        friend class Database;
+        Connection(Database* pool, std::unique_ptr<pqxx::connection> conn);
+
+        Database* pool;
+        std::unique_ptr<pqxx::connection> conn;
+    };
+
+    Database(const std::string& conn_str, PoolOptions options);
+
+    // Throws std::runtime_error if no connection frees up within wait_timeout
+    Connection acquire();
 
 private:
-    pqxx::connection conn;  // <-- plain object, not a reference
-};
+    struct Idle {
+        std::unique_ptr<pqxx::connection> conn;
+        std::chrono::steady_clock::time_point since;
+    };
 
-inline Database connect_db() {
-    cenvxx clangxx;
-    auto cenv = clangxx.init("../secrets/cenv");
+    std::string conn_str;
+    PoolOptions options;
 
-    std::string dbname = cenv.find_token("database", "dbname");
-    std::string user = cenv.find_token("database", "user");
-    std::string password = cenv.find_token("database", "password");
-    std::string host = cenv.find_token("database", "host");
+    std::mutex mtx;
+    std::condition_variable available;
+    std::deque<Idle> idle;
+    std::size_t open = 0; // idle + checked out
+
+    std::unique_ptr<pqxx::connection> open_connection();
+    bool healthy(Idle& entry);
+    void release(std::unique_ptr<pqxx::connection> conn);
+};
 
-    std::string conn_str = "dbname=" + dbname + " user=" + user + " password=" + password + " host=" + host;
-    Database db(conn_str);
+Database& database();
 
-    return db;
-}
\ No newline at end of file
+inline Database::Connection connect_db() {
+    return database().acquire();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Memory argon2id is configured with in hashPassword (m_cost = 1 << 16 KiB)
+constexpr std::size_t kArgon2MemoryBytes = std::size_t{1} << 26;
+
+// Fixed set of workers that run password hashing and verification off the
+// network threads. Workers are sized so their combined argon2 memory stays
+// within budget; the wait queue is bounded and full means "reject now".
+class HashPool {
+public:
+    HashPool(std::size_t workers, std::size_t max_queue);
+    ~HashPool();
+
+    // Returns false without queuing when the wait queue is already full
+    bool try_submit(std::function<void()> task);
+
+    void record_hash(std::chrono::steady_clock::duration elapsed);
+
+    json stats() const;
+
+private:
+    std::size_t max_queue;
+
+    mutable std::mutex mtx;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    std::size_t queue_peak = 0;
+    std::atomic<std::uint64_t> rejected{0};
+    std::atomic<std::uint64_t> completed{0};
+    std::atomic<std::uint64_t> hashes{0};
+    std::atomic<std::uint64_t> hash_ns_total{0};
+    std::atomic<std::uint64_t> hash_ns_max{0};
+
+    void work();
+};
+
+HashPool& hash_pool();
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Appends JSON straight into a caller's buffer (typically res.body()), so large
+// responses are serialized once instead of being built as a json tree and then
+// dumped. Commas are placed automatically; the caller keeps the nesting balanced.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out(out) {}
+
+    JsonWriter& begin_object();
+    JsonWriter& end_object();
+    JsonWriter& begin_array();
+    JsonWriter& end_array();
+
+    JsonWriter& key(std::string_view name);
+
+    JsonWriter& value(std::string_view text);
+    JsonWriter& value(const char* text) { return value(std::string_view(text)); }
+    JsonWriter& value(int number) { return value(static_cast<std::int64_t>(number)); }
+    JsonWriter& value(std::int64_t number);
+    JsonWriter& value(std::uint64_t number);
+    JsonWriter& value(bool flag);
+    JsonWriter& null();
+
+    template <typename T>
+    JsonWriter& value(const std::optional<T>& maybe) {
+        return maybe ? value(*maybe) : null();
+    }
+
+    // Already-serialized JSON, e.g. a small nlohmann::json dump()
+    JsonWriter& raw(std::string_view json);
+
+    void reserve(std::size_t extra) { out.reserve(out.size() + extra); }
+
+private:
+    std::string& out;
+    std::vector<bool> empty; // one entry per open container: nothing written yet
+    bool after_key = false;
+
+    void separate();
+};
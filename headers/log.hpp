@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Asynchronous logfmt logger. Each thread formats into its own lock-free
+// ring; one background thread drains every ring to stdout (debug, info) or
+// stderr (warn, error). A full ring drops the line rather than block.
+//
+//     LOG_INFO("client connected", {"sessions", n}, {"user", user_id});
+//
+// Levels below ATLAS_LOG_MIN_LEVEL are compiled out. The rest are checked
+// against the runtime level ([log] level in cenv) before any argument is
+// evaluated, so disabled payload dumps cost one relaxed load.
+enum class LogLevel : int { debug = 0, info = 1, warn = 2, error = 3, off = 4 };
+
+#ifndef ATLAS_LOG_MIN_LEVEL
+#define ATLAS_LOG_MIN_LEVEL 0
+#endif
+
+namespace atlas_log {
+
+struct Field {
+    std::string_view key;
+    std::string value;
+    bool quoted;
+
+    Field(std::string_view key, const std::string& value) : key(key), value(value), quoted(true) {}
+    Field(std::string_view key, std::string_view value) : key(key), value(value), quoted(true) {}
+    Field(std::string_view key, const char* value) : key(key), value(value ? value : ""), quoted(true) {}
+    Field(std::string_view key, const json& value) : key(key), value(value.dump()), quoted(true) {}
+    Field(std::string_view key, bool value) : key(key), value(value ? "true" : "false"), quoted(false) {}
+
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    Field(std::string_view key, T value) : key(key), value(std::to_string(value)), quoted(false) {}
+};
+
+extern std::atomic<int> runtime_level;
+
+inline bool enabled(LogLevel level) {
+    return static_cast<int>(level) >= runtime_level.load(std::memory_order_relaxed);
+}
+
+void set_level(LogLevel level);
+
+// Reads [log] level (debug, info, warn, error, off) and starts the writer
+void init();
+
+void write(LogLevel level, std::string_view msg, std::initializer_list<Field> fields = {});
+
+// Lines lost to full rings since startup
+std::uint64_t dropped();
+
+}
+
+#define ATLAS_LOG(level, msg, ...)                                                          \
+    do {                                                                                    \
+        if constexpr (static_cast<int>(level) >= ATLAS_LOG_MIN_LEVEL) {                     \
+            if (atlas_log::enabled(level)) atlas_log::write(level, msg, {__VA_ARGS__});     \
+        }                                                                                   \
+    } while (0)
+
+#define LOG_DEBUG(...) ATLAS_LOG(LogLevel::debug, __VA_ARGS__)
+#define LOG_INFO(...)  ATLAS_LOG(LogLevel::info, __VA_ARGS__)
+#define LOG_WARN(...)  ATLAS_LOG(LogLevel::warn, __VA_ARGS__)
+#define LOG_ERROR(...) ATLAS_LOG(LogLevel::error, __VA_ARGS__)
@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Bounded least-recently-used map split into independently locked shards so
+// concurrent readers rarely contend. Capacity is enforced per shard.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedLru {
+public:
+    struct Stats {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t evictions;
+        std::size_t size;
+    };
+
+    ShardedLru(std::size_t shard_count, std::size_t capacity_per_shard)
+        : capacity(capacity_per_shard) {
+        for (std::size_t i = 0; i < shard_count; ++i) {
+            shards.push_back(std::make_unique<Shard>());
+        }
+    }
+
+    std::optional<Value> get(const Key& key) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        // Move to the front: most recently used
+        shard.items.splice(shard.items.begin(), shard.items, it->second);
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second->second;
+    }
+
+    void put(const Key& key, Value value) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            it->second->second = std::move(value);
+            shard.items.splice(shard.items.begin(), shard.items, it->second);
+            return;
+        }
+
+        shard.items.emplace_front(key, std::move(value));
+        shard.index.emplace(key, shard.items.begin());
+
+        if (shard.items.size() > capacity) {
+            shard.index.erase(shard.items.back().first);
+            shard.items.pop_back();
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Applies fn to the cached value in place, if present. Returns whether it was.
+    template <typename Fn>
+    bool update(const Key& key, Fn&& fn) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) return false;
+
+        fn(it->second->second);
+        return true;
+    }
+
+    void erase(const Key& key) {
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) return;
+
+        shard.items.erase(it->second);
+        shard.index.erase(it);
+    }
+
+    void clear() {
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mtx);
+            shard->index.clear();
+            shard->items.clear();
+        }
+    }
+
+    Stats stats() const {
+        std::size_t size = 0;
+        for (const auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mtx);
+            size += shard->items.size();
+        }
+
+        return Stats{
+            hits.load(std::memory_order_relaxed),
+            misses.load(std::memory_order_relaxed),
+            evictions.load(std::memory_order_relaxed),
+            size
+        };
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mtx;
+        std::list<std::pair<Key, Value>> items;
+        std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> index;
+    };
+
+    std::size_t capacity;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> evictions{0};
+
+    Shard& shard_for(const Key& key) {
+        return *shards[Hash{}(key) % shards.size()];
+    }
+};
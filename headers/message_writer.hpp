@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "abstract.hpp"
+
+using json = nlohmann::json;
+
+// Group commit for new messages. Concurrent submits are collected for up to
+// one window (or until a batch fills) and written in a single transaction;
+// each callback runs only after that transaction has committed. At most
+// max_queue messages wait; past that, submits fail straight away.
+class MessageWriter {
+public:
+    struct Committed {
+        int id;
+        std::string timestamp; // as stored, "YYYY-MM-DD HH:MM:SS"
+    };
+
+    // Called on a writer thread with either the error that failed the message
+    // or its committed row. It holds up the next batch, so hand work off.
+    // A submit refused for a full queue calls it on the submitting thread.
+    using Done = std::function<void(std::exception_ptr error, const Committed& committed)>;
+
+    MessageWriter(std::size_t writers, std::size_t max_batch, std::size_t max_queue, std::chrono::microseconds window);
+    ~MessageWriter();
+
+    // Never blocks the caller on the database
+    void submit(const std::string& user_id, const MessageFormat& message, const std::string& timestamp, Done done);
+
+    json stats() const;
+
+private:
+    struct Pending {
+        std::string user_id;
+        MessageFormat message;
+        std::string timestamp;
+        Done done;
+    };
+
+    std::size_t max_batch;
+    std::size_t max_queue;
+    std::chrono::microseconds window;
+
+    mutable std::mutex mtx;
+    std::condition_variable ready;
+    std::deque<Pending> queue;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    std::atomic<std::uint64_t> batches{0};
+    std::atomic<std::uint64_t> messages{0};
+    std::atomic<std::uint64_t> fallbacks{0};
+    std::atomic<std::uint64_t> failed{0};
+    std::atomic<std::uint64_t> rejected{0};
+    std::atomic<std::uint64_t> batch_peak{0};
+
+    void work();
+    bool commit(std::vector<Pending>& batch);
+    static void finish(Pending& pending, std::exception_ptr error, const Committed& committed);
+};
+
+MessageWriter& message_writer();
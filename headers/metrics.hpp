@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Prometheus-style metrics. Counters and histograms are registered once (the
+// returned reference stays valid for the life of the process) and recorded
+// with relaxed atomics, so hot paths keep a reference instead of looking
+// anything up per event.
+
+class Counter {
+public:
+    void inc(std::uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t load() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint64_t> value{0};
+};
+
+// Log-linear buckets in the style of HDR histograms: every power of two is
+// split into four, giving ≤25% relative error from 1 up to 2^26 units.
+class Histogram {
+public:
+    static constexpr std::size_t kBuckets = 26 * 4;
+
+    // scale converts recorded units to exported ones (1e-6: µs → seconds)
+    explicit Histogram(double scale) : scale(scale) {}
+
+    void record(std::uint64_t value);
+
+    void write(std::string& out, const std::string& name, const std::string& labels) const;
+
+private:
+    double scale;
+    std::array<std::atomic<std::uint64_t>, kBuckets + 1> buckets{}; // last is overflow
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> sum{0};
+};
+
+// Records the lifetime of the scope, in microseconds
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+private:
+    Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+class Metrics {
+public:
+    // labels is a preformatted label set such as label("route", "/api/login")
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "", double scale = 1e-6);
+
+    // Read at scrape time
+    void gauge(const std::string& name, const std::string& help, std::function<double()> read);
+
+    // Every numeric field of the object becomes <prefix>_<field>
+    void json_gauges(const std::string& prefix, std::function<json()> read);
+
+    // Text exposition format, version 0.0.4
+    std::string prometheus();
+
+private:
+    struct Family {
+        std::string help;
+        std::string type;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;
+        std::function<double()> gauge;
+    };
+
+    std::mutex mtx;
+    std::map<std::string, Family> families;
+    std::vector<std::pair<std::string, std::function<json()>>> json_sources;
+};
+
+Metrics& metrics();
+
+// key="value" with the value escaped for the exposition format
+std::string label(const std::string& key, const std::string& value);
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Authoritative online / idle / offline state. Connects, disconnects and
+// explicit updates only touch memory; a background thread publishes the net
+// change per user once per fan-out tick and writes statuses to Postgres on a
+// slower cadence, so a client flapping between idle and online costs nothing
+// until it settles.
+class Presence {
+public:
+    using Publish = std::function<void(const std::string& user_id, const std::string& status)>;
+
+    Presence(std::chrono::milliseconds fanout_interval, std::chrono::milliseconds flush_interval);
+
+    static bool valid(const std::string& status);
+
+    void connect(const std::string& user_id);
+    void disconnect(const std::string& user_id);
+
+    // Explicit choice by the user; ignored for users with no open session
+    void set(const std::string& user_id, const std::string& status);
+
+    // Effective status; nullopt for users with no open session whose offline
+    // state has already been published and saved
+    std::optional<std::string> status(const std::string& user_id);
+
+    // Starts the fan-out / flush thread; call once
+    void start(Publish publish);
+
+    json stats();
+
+private:
+    struct Entry {
+        std::size_t sessions = 0;
+        std::string chosen = "online";     // what the user asked for
+        std::string published = "offline"; // what peers were last told
+    };
+
+    std::chrono::milliseconds fanout_interval;
+    std::chrono::milliseconds flush_interval;
+
+    std::mutex mtx;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_set<std::string> changed;               // since the last fan-out
+    std::unordered_map<std::string, std::string> unsaved;  // user_id → status, since the last flush
+
+    std::atomic<std::uint64_t> updates{0};
+    std::atomic<std::uint64_t> published{0};
+    std::atomic<std::uint64_t> flushed{0};
+
+    static const std::string& effective(const Entry& entry);
+    void mark_locked(const std::string& user_id);
+    void release_locked(const std::string& user_id);
+
+    void fan_out(const Publish& publish);
+    void flush();
+};
+
+Presence& presence();
@@ -0,0 +1,81 @@
+#pragma once
+#include <boost/beast/http.hpp>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Values captured from the {name} segments of a matched pattern
+class RouteParams {
+public:
+    // Throws std::out_of_range if the pattern has no such parameter
+    const std::string& at(std::string_view name) const;
+
+    std::vector<std::pair<std::string, std::string>> values;
+};
+
+// Dispatches on method plus path. Static paths resolve with one hash lookup;
+// patterns such as /api/servers/{sid}/messages walk a segment trie. The query
+// string is ignored for matching.
+class Router {
+public:
+    using Request = boost::beast::http::request<boost::beast::http::string_body>;
+    using Response = boost::beast::http::response<boost::beast::http::string_body>;
+    using Handler = std::function<Response(const Request&, const RouteParams&)>;
+
+    struct Route {
+        boost::beast::http::verb method;
+        std::string pattern;
+        std::vector<std::string> param_names;
+        Handler handler;
+    };
+
+    struct Match {
+        const Route* route = nullptr;
+        RouteParams params;
+        std::string allow; // methods the path does accept, when route is null
+    };
+
+    Router();
+    ~Router();
+
+    void add(boost::beast::http::verb method, const std::string& pattern, Handler handler);
+
+    // Handlers that take no path parameters
+    void add(boost::beast::http::verb method, const std::string& pattern, std::function<Response(const Request&)> handler);
+
+    void get(const std::string& pattern, Handler handler) { add(boost::beast::http::verb::get, pattern, std::move(handler)); }
+    void get(const std::string& pattern, std::function<Response(const Request&)> handler) { add(boost::beast::http::verb::get, pattern, std::move(handler)); }
+    void post(const std::string& pattern, std::function<Response(const Request&)> handler) { add(boost::beast::http::verb::post, pattern, std::move(handler)); }
+
+    Match match(boost::beast::http::verb method, std::string_view target) const;
+
+    // Visits every registered route, e.g. to wrap handlers after registration
+    template <typename Fn>
+    void for_each(Fn&& fn) {
+        for (auto& route : routes) fn(*route);
+    }
+
+private:
+    struct Node;
+
+    // Lets static_paths be probed with the string_view of the target, no copy
+    struct PathHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view path) const { return std::hash<std::string_view>{}(path); }
+    };
+
+    std::vector<std::unique_ptr<Route>> routes;
+    std::unordered_map<std::string, std::vector<const Route*>, PathHash, std::equal_to<>> static_paths; // path → one route per method
+    std::unique_ptr<Node> root;
+};
+
+// Target without its query string
+std::string_view route_path(std::string_view target);
+
+// Percent-decoded value of ?key=value in the request target, if present
+std::optional<std::string> query_param(const Router::Request& req, std::string_view key);
@@ -0,0 +1,64 @@
+#pragma once
+#include <pqxx/pqxx>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Every SQL statement the data functions run. Each one is prepared once per
+// pooled connection and executed by name, so Postgres parses and plans it once.
+// Indexes they rely on ship as migrations under sql/.
+enum class Stmt : std::size_t {
+    user_exists,
+    create_account,
+    update_account,
+    login_user,
+    get_user,
+    get_user_all,
+    user_get_all_servers,
+    set_user_appearance_status,
+    get_messages_latest,
+    get_messages_before,
+    get_messages_after,
+    reserve_message_ids,
+    insert_messages,
+    delete_message,
+    edit_message,
+    server_get_all_users,
+    get_server,
+    join_server,
+    create_server,
+    verify_invite,
+    count
+};
+
+struct PreparedStatement {
+    const char* name;
+    const char* sql;
+};
+
+const PreparedStatement& statement(Stmt id);
+
+// Called by the pool on every freshly opened connection
+void prepare_statements(pqxx::connection& conn);
+
+void count_statement(Stmt id);
+
+// Feeds the per-statement latency histogram on /api/metrics
+void record_statement(Stmt id, std::chrono::steady_clock::duration elapsed);
+
+// {"<name>": <executions>} for every registered statement
+json statement_stats();
+
+template<typename... Args>
+pqxx::result exec_stmt(pqxx::transaction_base& txn, Stmt id, Args&&... args) {
+    count_statement(id);
+
+    auto start = std::chrono::steady_clock::now();
+    pqxx::result r = txn.exec_prepared(statement(id).name, std::forward<Args>(args)...);
+    record_statement(id, std::chrono::steady_clock::now() - start);
+
+    return r;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "abstract.hpp"
+
+// Everything the data functions persist, behind one interface so the server
+// can run on Postgres or entirely in memory. Backends return plain structs;
+// shaping JSON and caching stay in the data functions. Failures throw.
+class Storage {
+public:
+    virtual ~Storage() = default;
+
+    virtual const char* name() const = 0;
+
+    // Users
+    virtual bool user_exists(const std::string& username) = 0;
+    virtual void create_user(const User& user, const std::string& password_hash) = 0;
+    // Writes every profile field except status, which presence owns; backends
+    // must leave the stored status as it is whatever user.status holds
+    virtual void update_user(const User& user) = 0;
+    virtual std::optional<std::string> password_hash(const std::string& username) = 0;
+    virtual std::optional<User> user_by_name(const std::string& username) = 0;
+    virtual std::optional<User> user_by_id(const std::string& user_id) = 0;
+    virtual void set_statuses(const std::vector<std::pair<std::string, std::string>>& statuses) = 0; // user_id, status
+
+    // Servers and membership
+    virtual std::vector<Server> servers_of(const std::string& user_id) = 0;
+    virtual std::vector<User> members_of(const std::string& server_id) = 0;
+    virtual std::optional<Server> server(const std::string& server_id) = 0;
+    virtual void create_server(const Server& server) = 0;
+    virtual void join_server(const std::string& server_id, const std::string& user_id) = 0; // throws AlreadyMember
+    virtual std::optional<Invite> invite(const std::string& code) = 0;
+
+    // Messages. Rows carry the author's current name and picture and the raw
+    // "YYYY-MM-DD HH:MM:SS" timestamp. Newest first, except for cursor.after
+    // pages which come oldest first; at most `fetch` rows.
+    virtual std::vector<MessageFormat> messages(const std::string& server_id, const MessageCursor& cursor, int fetch) = 0;
+
+    // All rows or none; returns the assigned ids in input order. Throws
+    // RowRejected when the data itself is refused, anything else when the
+    // database could not be reached.
+    virtual std::vector<int> insert_messages(const std::vector<MessageFormat>& messages) = 0;
+
+    // Both return the message's server, or nullopt if it did not exist
+    virtual std::optional<std::string> delete_message(int message_id) = 0;
+    virtual std::optional<std::string> edit_message(int message_id, const std::string& content) = 0;
+};
+
+struct AlreadyMember : std::runtime_error {
+    AlreadyMember() : std::runtime_error("User is already in server") {}
+};
+
+struct RowRejected : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+std::unique_ptr<Storage> make_postgres_storage();
+std::unique_ptr<Storage> make_memory_storage();
+
+// Chooses the backend ("postgres" or "memory") before the first storage()
+// call; otherwise [storage] backend in cenv decides, defaulting to postgres.
+void use_storage(const std::string& backend);
+
+Storage& storage();
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Threads for handlers that may block on the database or disk, so a saturated
+// connection pool stalls these workers instead of the io threads. Like the
+// hash pool, the wait queue is bounded and full means "reject now".
+class WorkerPool {
+public:
+    WorkerPool(std::size_t workers, std::size_t max_queue);
+    ~WorkerPool();
+
+    // Returns false without queuing when the wait queue is already full
+    bool try_submit(std::function<void()> task);
+
+    json stats() const;
+
+private:
+    std::size_t max_queue;
+
+    mutable std::mutex mtx;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    std::size_t queue_peak = 0;
+    std::atomic<std::uint64_t> rejected{0};
+    std::atomic<std::uint64_t> completed{0};
+
+    void work();
+};
+
+// Sized from [workers] threads / queue_size; defaults match the DB pool's max_size
+WorkerPool& worker_pool();
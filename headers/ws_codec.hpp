@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Encoding of the {"event", "data"} envelope on one WebSocket. JSON travels in
+// text frames; the binary encodings are opted into through Sec-WebSocket-Protocol
+// and travel in binary frames, where "data" may also carry raw bytes.
+enum class WsCodec { json, msgpack, cbor };
+
+constexpr std::size_t kWsCodecCount = 3;
+
+// First protocol in the client's Sec-WebSocket-Protocol list that we speak
+// (atlas.json, atlas.msgpack, atlas.cbor), or nullopt to fall back to plain
+// JSON without echoing a protocol
+std::optional<WsCodec> ws_negotiate(std::string_view offered);
+
+const char* ws_protocol_name(WsCodec codec);
+
+std::string ws_encode(const json& event, WsCodec codec);
+
+// Throws nlohmann::json::exception on a malformed frame
+json ws_decode(std::string_view frame, WsCodec codec);
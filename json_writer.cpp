@@ -0,0 +1,118 @@
+#include "headers/json_writer.hpp"
+#include <charconv>
+
+void JsonWriter::separate() {
+    if (after_key) {
+        after_key = false;
+        return;
+    }
+
+    if (!empty.empty()) {
+        if (!empty.back()) out += ',';
+        empty.back() = false;
+    }
+}
+
+JsonWriter& JsonWriter::begin_object() {
+    separate();
+    out += '{';
+    empty.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_object() {
+    out += '}';
+    empty.pop_back();
+    return *this;
+}
+
+JsonWriter& JsonWriter::begin_array() {
+    separate();
+    out += '[';
+    empty.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_array() {
+    out += ']';
+    empty.pop_back();
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+    value(name);
+    out += ':';
+    after_key = true;
+    return *this;
+}
+
+// Escapes the same characters as nlohmann's dump(); UTF-8 passes through as is
+JsonWriter& JsonWriter::value(std::string_view text) {
+    static constexpr char hex[] = "0123456789abcdef";
+
+    separate();
+    out += '"';
+
+    std::size_t run = 0; // start of the pending unescaped run
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+        }
+    }
+
+    out.append(text.data() + run, text.size() - run);
+    out += '"';
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(std::int64_t number) {
+    separate();
+
+    char buf[24];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), number);
+    out.append(buf, end);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(std::uint64_t number) {
+    separate();
+
+    char buf[24];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), number);
+    out.append(buf, end);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    separate();
+    out += flag ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    separate();
+    out += "null";
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json) {
+    separate();
+    out += json;
+    return *this;
+}
@@ -0,0 +1,189 @@
+#include "headers/log.hpp"
+#include "headers/cenv.hpp"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace atlas_log {
+
+std::atomic<int> runtime_level{static_cast<int>(LogLevel::info)};
+
+namespace {
+
+constexpr std::size_t kRingSize = 1024; // lines per thread; power of two
+
+struct Line {
+    LogLevel level;
+    std::string text;
+};
+
+// Single producer (the owning thread), single consumer (the writer)
+struct Ring {
+    std::array<Line, kRingSize> lines;
+    std::atomic<std::size_t> head{0}; // next slot the producer fills
+    std::atomic<std::size_t> tail{0}; // next slot the consumer reads
+
+    bool push(LogLevel level, std::string&& text) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == kRingSize) return false;
+
+        lines[h % kRingSize] = Line{level, std::move(text)};
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Fn>
+    std::size_t drain(Fn&& fn) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t h = head.load(std::memory_order_acquire);
+
+        for (std::size_t i = t; i < h; ++i) {
+            fn(lines[i % kRingSize]);
+        }
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+};
+
+std::mutex registry_mtx;
+std::vector<std::shared_ptr<Ring>>* registry = new std::vector<std::shared_ptr<Ring>>(); // never destroyed; the writer outlives main
+std::atomic<std::uint64_t> lost{0};
+std::once_flag started;
+
+Ring& local_ring() {
+    thread_local std::shared_ptr<Ring> ring = [] {
+        auto r = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        registry->push_back(r);
+        return r;
+    }();
+    return *ring;
+}
+
+const char* level_name(LogLevel level) {
+    switch (level) {
+        case LogLevel::debug: return "debug";
+        case LogLevel::info:  return "info";
+        case LogLevel::warn:  return "warn";
+        case LogLevel::error: return "error";
+        default:              return "off";
+    }
+}
+
+void append_quoted(std::string& out, std::string_view value) {
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:   out += c;
+        }
+    }
+    out += '"';
+}
+
+void writer() {
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::string out, err;
+
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(registry_mtx);
+            rings = *registry;
+        }
+
+        std::size_t drained = 0;
+        for (auto& ring : rings) {
+            drained += ring->drain([&](Line& line) {
+                (line.level >= LogLevel::warn ? err : out) += line.text;
+                line.text.clear();
+            });
+        }
+
+        if (!out.empty()) {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+            out.clear();
+        }
+        if (!err.empty()) {
+            std::fwrite(err.data(), 1, err.size(), stderr);
+            err.clear();
+        }
+
+        if (!drained) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+}
+
+}
+
+void set_level(LogLevel level) {
+    runtime_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void init() {
+    std::call_once(started, [] {
+        std::string level = atlas_cenv().find_token("log", "level");
+        if (level == "debug")      set_level(LogLevel::debug);
+        else if (level == "warn")  set_level(LogLevel::warn);
+        else if (level == "error") set_level(LogLevel::error);
+        else if (level == "off")   set_level(LogLevel::off);
+        else                       set_level(LogLevel::info);
+
+        std::thread(writer).detach();
+    });
+}
+
+void write(LogLevel level, std::string_view msg, std::initializer_list<Field> fields) {
+    std::string line;
+    line.reserve(64 + msg.size());
+
+    // ts=2026-01-01T12:00:00.123Z level=info msg="..." key=value
+    auto now = std::chrono::system_clock::now();
+    std::time_t t = std::chrono::system_clock::to_time_t(now);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+    char ts[32];
+    std::snprintf(ts, sizeof ts, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                  tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<int>(ms));
+
+    line += "ts=";
+    line += ts;
+    line += " level=";
+    line += level_name(level);
+    line += " msg=";
+    append_quoted(line, msg);
+
+    for (const auto& field : fields) {
+        line += ' ';
+        line += field.key;
+        line += '=';
+        if (field.quoted) {
+            append_quoted(line, field.value);
+        } else {
+            line += field.value;
+        }
+    }
+    line += '\n';
+
+    if (!local_ring().push(level, std::move(line))) {
+        lost.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::uint64_t dropped() {
+    return lost.load(std::memory_order_relaxed);
+}
+
+}
@@ -4,18 +4,38 @@
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <cstddef>
+#include <cstdio>
 #include <exception>
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <functional>
 #include <thread>
 #include <chrono>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <array>
 #include <nlohmann/json.hpp>
 #include "headers/database.hpp"
 #include "headers/messaging.hpp"
+#include "headers/statements.hpp"
+#include "headers/storage.hpp"
+#include "headers/auth.hpp"
+#include "headers/hashing.hpp"
+#include "headers/worker_pool.hpp"
+#include "headers/cache.hpp"
+#include "headers/message_writer.hpp"
+#include "headers/presence.hpp"
+#include "headers/log.hpp"
+#include "headers/metrics.hpp"
+#include "headers/router.hpp"
+#include "headers/json_writer.hpp"
+#include "headers/ws_codec.hpp"
 #include <jwt-cpp/jwt.h>
 #include <vector>
 #include "headers/cenv.hpp"
@@ -32,52 +52,183 @@ namespace ssl = boost::asio::ssl;
 using tcp = net::ip::tcp;
 using json = nlohmann::json;
 
-cenvxx clangxx;
-auto cenv = clangxx.init("../secrets/cenv");
-
-std::string secret = cenv.find_token("secrets", "securekey");
+//------------------------------------------------------------
+// WebSocket session (async read loop + serialized write queue)
+//------------------------------------------------------------
+// A client whose outbound backlog grows past either limit is disconnected so
+// it cannot hold memory or delay anyone else.
+constexpr std::size_t kWsMaxQueuedFrames = 256;
+constexpr std::size_t kWsMaxQueuedBytes = 4 * 1024 * 1024;
+
+class WebSocketSession;
+using WsEventHandler = std::function<json(WebSocketSession&, const json&)>;
+
+class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+public:
+    explicit WebSocketSession(tcp::socket&& socket) : ws(std::move(socket)) {}
+
+    void run(http::request<http::string_body> req);
+
+    // Safe to call from any thread; the frame is queued on the session strand.
+    // Broadcasts pass one shared buffer to every recipient instead of copies,
+    // so the payload must already be encoded with this session's codec.
+    void send(std::shared_ptr<const std::string> payload);
+    void send(const json& event);
+
+    // Runs fn on the session strand, e.g. to reply once a background job is done
+    void defer(std::function<void()> fn);
+
+    // Bound once, at upgrade or by the first frame; only touched on the strand
+    std::string user_id;
+    void authenticate(const std::string& token);
+
+    // Negotiated before the session is registered and never changed afterwards,
+    // so broadcasters on other threads may read it
+    WsCodec codec = WsCodec::json;
+
+private:
+    websocket::stream<beast::tcp_stream> ws;
+    beast::flat_buffer buffer;
+
+    // Only touched on the strand
+    std::deque<std::shared_ptr<const std::string>> queue;
+    std::size_t queued_bytes = 0;
+    bool evicted = false;
+
+    std::string upgrade_token; // credentials presented with the upgrade request
+
+    void on_accept(beast::error_code ec);
+    void do_read();
+    void on_read(beast::error_code ec, std::size_t bytes);
+    void do_write();
+    void on_write(beast::error_code ec, std::size_t bytes);
+    void evict();
+    void run_blocking(const WsEventHandler& handler, json data);
+};
 
 // -------------------------
 // Global session manager
 // -------------------------
 struct WebSocketSessionManager {
     std::mutex mtx;
-    std::vector<std::shared_ptr<websocket::stream<tcp::socket>>> sessions;
+    std::vector<std::shared_ptr<WebSocketSession>> sessions;
 
-    void add(std::shared_ptr<websocket::stream<tcp::socket>> ws) {
+    // server_id → sessions subscribed to it, plus the reverse index for cleanup
+    std::unordered_map<std::string, std::unordered_set<std::shared_ptr<WebSocketSession>>> subscribers;
+    std::unordered_map<std::shared_ptr<WebSocketSession>, std::unordered_set<std::string>> subscriptions;
+
+    void add(std::shared_ptr<WebSocketSession> ws) {
         std::lock_guard<std::mutex> lock(mtx);
         sessions.push_back(ws);
     }
 
-    void remove(std::shared_ptr<websocket::stream<tcp::socket>> ws) {
+    // Called once per session, on its strand; an authenticated user with no
+    // other open session goes offline
+    void remove(std::shared_ptr<WebSocketSession> ws) {
+        if (!ws->user_id.empty()) {
+            presence().disconnect(ws->user_id);
+        }
+
         std::lock_guard<std::mutex> lock(mtx);
         sessions.erase(std::remove(sessions.begin(), sessions.end(), ws), sessions.end());
+
+        auto it = subscriptions.find(ws);
+        if (it == subscriptions.end()) return;
+
+        for (const auto& server_id : it->second) {
+            unsubscribe_locked(ws, server_id);
+        }
+        subscriptions.erase(it);
     }
 
-    void broadcast(const json& msg) {
+    void subscribe(std::shared_ptr<WebSocketSession> ws, const std::string& server_id) {
         std::lock_guard<std::mutex> lock(mtx);
-        for (auto& s : sessions) {
-            try {
-                s->text(true);
-                s->write(net::buffer(msg.dump()));
-            } catch (...) {
-                // Ignore failed sends
+        subscribers[server_id].insert(ws);
+        subscriptions[ws].insert(server_id);
+    }
+
+    void unsubscribe(std::shared_ptr<WebSocketSession> ws, const std::string& server_id) {
+        std::lock_guard<std::mutex> lock(mtx);
+        unsubscribe_locked(ws, server_id);
+
+        auto it = subscriptions.find(ws);
+        if (it != subscriptions.end()) {
+            it->second.erase(server_id);
+        }
+    }
+
+    std::size_t count() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return sessions.size();
+    }
+
+    // Delivers to the subscribers of one server only. The lock is held just long
+    // enough to copy the recipient list; send() itself only enqueues.
+    void broadcast(const std::string& server_id, const json& msg) {
+        std::vector<std::shared_ptr<WebSocketSession>> targets;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            auto it = subscribers.find(server_id);
+            if (it == subscribers.end()) return;
+            targets.assign(it->second.begin(), it->second.end());
+        }
+
+        static Histogram& fanout = metrics().histogram("atlas_broadcast_fanout", "Recipients per broadcast", "", 1.0);
+        fanout.record(targets.size());
+
+        deliver(targets, msg);
+    }
+
+    // Delivers once to every session subscribed to any of the given servers
+    void broadcast_to_servers(const std::vector<std::string>& server_ids, const json& msg) {
+        std::unordered_set<std::shared_ptr<WebSocketSession>> targets;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            for (const auto& server_id : server_ids) {
+                auto it = subscribers.find(server_id);
+                if (it == subscribers.end()) continue;
+                targets.insert(it->second.begin(), it->second.end());
             }
         }
+
+        if (targets.empty()) return;
+
+        static Histogram& fanout = metrics().histogram("atlas_broadcast_fanout", "Recipients per broadcast", "", 1.0);
+        fanout.record(targets.size());
+
+        deliver(targets, msg);
     }
-};
 
-inline WebSocketSessionManager g_sessions; // 🔥 define globally before functions
+private:
+    // Encodes the event once per codec in use among the recipients; sessions
+    // sharing a codec share the buffer
+    template <typename Sessions>
+    static void deliver(const Sessions& targets, const json& msg) {
+        std::array<std::shared_ptr<const std::string>, kWsCodecCount> payloads;
+
+        for (auto& s : targets) {
+            auto& payload = payloads[static_cast<std::size_t>(s->codec)];
+            if (!payload) {
+                payload = std::make_shared<const std::string>(ws_encode(msg, s->codec));
+            }
+            s->send(payload);
+        }
+    }
 
-//------------------------------------------------------------
-// Type alias for HTTP route handlers
-//------------------------------------------------------------
+    void unsubscribe_locked(const std::shared_ptr<WebSocketSession>& ws, const std::string& server_id) {
+        auto it = subscribers.find(server_id);
+        if (it == subscribers.end()) return;
 
-// Change this:
-// using HttpRoute = std::function<json(const http::request<http::string_body>&)>;
+        it->second.erase(ws);
+        if (it->second.empty()) {
+            subscribers.erase(it);
+        }
+    }
+};
 
-// TO THIS:
-using HttpRoute = std::function<http::response<http::string_body>(const http::request<http::string_body>&)>;
+inline WebSocketSessionManager g_sessions; // 🔥 define globally before functions
 
 //------------------------------------------------------------
 // Helper to send HTTP JSON response (with added CORS headers)
@@ -102,24 +253,35 @@ void send_json_response(tcp::socket& socket,
     http::write(socket, res);
 }
 
-//------------------------------------------------------------
-// Handle regular HTTP requests
-//------------------------------------------------------------
-// The NEW handle_http:
+// If-None-Match is "*" or a comma-separated list of tags, each possibly weak
+// (W/"..."); GET revalidation uses the weak comparison, so W/ is ignored
+static bool etag_matches(std::string_view if_none_match, std::string_view etag)
+{
+    while (!if_none_match.empty()) {
+        std::size_t comma = if_none_match.find(',');
+        std::string_view tag = if_none_match.substr(0, comma);
+        if_none_match.remove_prefix(comma == std::string_view::npos ? if_none_match.size() : comma + 1);
+
+        std::size_t start = tag.find_first_not_of(" \t");
+        if (start == std::string_view::npos) continue;
+        tag = tag.substr(start, tag.find_last_not_of(" \t") - start + 1);
+
+        if (tag == "*") return true;
+        if (tag.substr(0, 2) == "W/") tag.remove_prefix(2);
+        if (tag == etag) return true;
+    }
+    return false;
+}
 
 //------------------------------------------------------------
-// Handle regular HTTP requests (The FINAL, working version)
+// Handle regular HTTP requests (returns the response; the session writes it)
 //------------------------------------------------------------
-void handle_http(tcp::socket& socket,
-                 const http::request<http::string_body>& req,
-                 const std::map<std::string, HttpRoute>& routes)
+http::response<http::string_body> handle_http(const http::request<http::string_body>& req,
+                                              const Router& routes)
 {
-    // 1. Get the requested path
-    std::string path{req.target().data(), req.target().size()};
-
     // 🔥 CATCH THE OPTIONS (PREFLIGHT) REQUEST FIRST 🔥
     if (req.method() == http::verb::options) {
-        http::response<http::empty_body> res{http::status::ok, req.version()};
+        http::response<http::string_body> res{http::status::ok, req.version()};
         res.set(http::field::server, "Boost.Beast");
 
         // The browser is hitting 100.95.199.94:8080 from localhost:3000
@@ -128,19 +290,29 @@ void handle_http(tcp::socket& socket,
         res.set(http::field::access_control_allow_methods, "GET, POST, OPTIONS");
         res.set(http::field::access_control_allow_headers, "Content-Type, Authorization"); 
         res.set(http::field::access_control_max_age, "86400"); // Cache preflight result
+        res.prepare_payload();
 
-        // Send the empty response immediately
-        http::write(socket, res);
-        return; 
+        return res;
     }
     
-    // 2. Handle Actual Request (GET, POST, etc.)
-    auto it = routes.find(path);
+    // 2. Handle Actual Request (GET, POST, etc.), matched on method and path
+    auto match = routes.match(req.method(), {req.target().data(), req.target().size()});
     http::response<http::string_body> res; 
 
-    if (it != routes.end()) {
+    if (match.route) {
         // Route handler returns the final response object (with cookies/body)
-        res = it->second(req); 
+        res = match.route->handler(req, match.params);
+    } else if (!match.allow.empty()) {
+        // Known path, wrong method
+        json response_body;
+        response_body["error"] = "Method not allowed";
+
+        res.result(http::status::method_not_allowed);
+        res.set(http::field::server, "Boost.Beast");
+        res.set(http::field::allow, match.allow);
+        res.set(http::field::content_type, "application/json");
+        res.body() = response_body.dump();
+        res.prepare_payload();
     } else {
         // Handle 404 Not Found 
         json response_body;
@@ -153,25 +325,40 @@ void handle_http(tcp::socket& socket,
         res.prepare_payload();
     }
 
+    // Successful reads carry a validator so browsers and proxies can revalidate
+    // with If-None-Match and get an empty 304 instead of the body again
+    bool head = req.method() == http::verb::head;
+    if ((req.method() == http::verb::get || head) && res.result() == http::status::ok) {
+        char etag[24];
+        std::snprintf(etag, sizeof(etag), "\"%016zx\"", std::hash<std::string>{}(res.body()));
+        res.set(http::field::etag, etag);
+
+        auto if_none_match = req[http::field::if_none_match];
+        if (etag_matches({if_none_match.data(), if_none_match.size()}, etag)) {
+            // A 304 carries no body, and no Content-Length unless it equals the 200's
+            res.result(http::status::not_modified);
+            res.body().clear();
+            res.erase(http::field::content_length);
+        }
+    }
+
+    // HEAD ran the GET handler; send its headers, with the GET's length, and no body
+    if (head && res.result() != http::status::not_modified) {
+        res.content_length(res.body().size());
+        res.body().clear();
+    }
+
     res.set(http::field::access_control_allow_origin, "*"); 
     res.set(http::field::access_control_allow_credentials, "true");
     
-    // Write the resulting response
-    http::write(socket, res);
+    return res;
 }
 
-std::string decode_token(const std::string& token) {
-    auto decoded = jwt::decode(token);
-    jwt::verify().allow_algorithm(jwt::algorithm::hs256{secret}).verify(decoded);
-    
-    return decoded.get_subject();
-};
-
-std::string set_user_appearance_status(const std::string& UUID, const std::string& status);
-json create_message(const std::string& user_id, const MessageFormat& message);
+void create_message(const std::string& user_id, const MessageFormat& message, std::function<void(json)> done);
 json delete_message(int message_id);
 json edit_message(int message_id, std::string& content);
 json get_user_all(const std::string& UUID);
+json user_get_all_servers(const std::string& UUID);
 json verify_invite(const std::string code);
 json join_server(const std::string server_id, const std::string UUID);
 json get_server(const std::string server_id);
@@ -219,38 +406,63 @@ std::string parse_bearer_token(const http::request<http::string_body>& req) {
         throw std::runtime_error(token + " | Something has happened");
     }
 
-    auto decoded = jwt::decode(token);
-    jwt::verify().allow_algorithm(jwt::algorithm::hs256{secret}).verify(decoded);
-    
-    // Return the subject (user ID)
-    return decoded.get_subject();
+    // Return the subject (user ID); repeat tokens are answered from the cache
+    return decode_token(token);
 }
 
-void handle_images(auto ws, beast::flat_buffer buffer, const std::string image_name) {
-    std::cout << "[WebSocket] Received binary data of size: " << buffer.size() << "\n";
+// Token presented on a WebSocket upgrade, from the Authorization header, the
+// token cookie or a ?token= query parameter. Empty if there is none.
+std::string request_token(const http::request<http::string_body>& req) {
+    auto extract = [](const std::string& source, const std::string& key) -> std::string {
+        size_t start = source.find(key);
+        if (start == std::string::npos) return "";
+        start += key.size();
+        size_t end = source.find_first_of(";&", start);
+        return source.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    };
+
+    if (req.count(http::field::authorization)) {
+        std::string bearer_token = std::string(req[http::field::authorization]);
+        if (bearer_token.rfind("Bearer ", 0) == 0) {
+            return bearer_token.substr(7);
+        }
+    }
+
+    if (req.count(http::field::cookie)) {
+        std::string token = extract(std::string(req[http::field::cookie]), "token=");
+        if (!token.empty()) return token;
+    }
+
+    std::string target{req.target().data(), req.target().size()};
+    size_t query = target.find('?');
+    if (query != std::string::npos) {
+        return extract("&" + target.substr(query + 1), "&token=");
+    }
+
+    return "";
+}
+
+void save_profile_image(const std::string& user_id, const char* data, std::size_t size, const std::string& image_name) {
     std::string base = "../uploads/users/photos/";
     std::string fpath = base + image_name;
 
-    std::string message = beast::buffers_to_string(buffer.data());
-
     // Save the uploaded file
     std::ofstream out(fpath, std::ios::binary);
-    out.write(static_cast<const char*>(buffer.data().data()), buffer.size());
+    out.write(data, size);
     out.close();
 
-    // Send acknowledgment back to client
-    json ack = {{"event", "upload_profile_ack"}, {"data", {{"status", "success"}}}};
-    ws->text(true);
-    ws->write(net::buffer(ack.dump()));
+    if (!out) {
+        throw std::runtime_error("Could not save profile image");
+    }
 
-    std::cout << "[Server] Profile image saved!\n";
+    LOG_INFO("profile image saved", {"user", user_id}, {"path", fpath}, {"bytes", size});
 }
 
 int discord_sendM(const std::string username, const std::string message) {        
     try {
         const std::string host = "discord.com";
         const std::string port = "443";
-        std::string target = cenv.find_token("hooks", "webhook_key");
+        std::string target = atlas_cenv().find_token("hooks", "webhook_key");
             
         int version = 11; // HTTP/1.1
 
@@ -305,426 +517,865 @@ int discord_sendM(const std::string username, const std::string message) {
 }
 
 //------------------------------------------------------------
-// Handle WebSocket connections
+// WebSocket event handlers (built once, shared by every session)
 //------------------------------------------------------------
-void handle_websocket(tcp::socket socket, const http::request<http::string_body>& req)
+
+// Verifies the token once, binds its subject to this socket and subscribes it
+// to every server the user belongs to. Throws if the token is invalid or the
+// worker pool has no room for the membership lookup.
+void WebSocketSession::authenticate(const std::string& token)
 {
-    try {
-        auto ws = std::make_shared<websocket::stream<tcp::socket>>(std::move(socket));
-        ws->accept(req);
-        g_sessions.add(ws);
+    if (!user_id.empty()) return;
+    std::string subject = decode_token(token);
+
+    // The server list may come from the database; subscribe from a worker
+    bool queued = worker_pool().try_submit([self = shared_from_this(), subject] {
+        json servers = user_get_all_servers(subject);
+        for (const auto& server : servers.value("server", json::array())) {
+            g_sessions.subscribe(self, server.value("serverID", ""));
+        }
+    });
+    if (!queued) {
+        throw std::runtime_error("Server busy, try again shortly");
+    }
 
-        std::cout << "[WebSocket] Client connected! Total: "
-                  << g_sessions.sessions.size() << "\n";
+    user_id = std::move(subject);
+    presence().connect(user_id);
+}
 
-        std::map<std::string, std::function<json(const json&)>> eventHandlers;
+std::map<std::string, WsEventHandler> make_event_handlers()
+{
+    std::map<std::string, WsEventHandler> eventHandlers;
 
-        eventHandlers["send_message"] = [&](const json& data) {
-            http::response<http::string_body> res{http::status::unauthorized, req.version()};
-            
-            std::string content = data.value("message", "");
-            std::string sid = data.value("sid", "");
-            std::string token = data.value("token", "");
+    // The dispatcher has already verified the token by the time this runs
+    eventHandlers["auth"] = [](WebSocketSession& session, const json&) {
+        if (session.user_id.empty()) {
+            return json{{"event", "error"}, {"data", {{"message", "Missing token"}}}};
+        }
 
-            std::string user_id = decode_token(token);
-            
-            json user = get_user_all(user_id);
-            std::string picture = user.value("picture", "");
-            std::string displayName = user.value("displayName", "");
+        return json{{"event", "auth_ok"}, {"data", {{"userID", session.user_id}}}};
+    };
 
-            std::optional<std::string> link = (data.contains("link") && !data["link"].is_null()) 
-            ? std::make_optional(data["link"].get<std::string>()) 
-            : std::nullopt;
-            
-            std::optional<int> mRef;
-            
-            MessageFormat message {
-                .serverID = sid,
-                .content = content,
-                .messageRef = mRef,
-                .link = link
-            };
+    eventHandlers["send_message"] = [](WebSocketSession& session, const json& data) {
+        std::string content = data.value("message", "");
+        std::string sid = data.value("sid", "");
 
-            json message_object = create_message(user_id, message);
-            std::string message_id = message_object.value("id", "");
-            std::string time = message_object.value("timestamp", "");
+        const std::string& user_id = session.user_id;
+        
+        json user = get_user_all(user_id);
+        std::string picture = user.value("picture", "");
+        std::string displayName = user.value("displayName", "");
 
-            // discord_sendM(displayname, text);
+        std::optional<std::string> link = (data.contains("link") && !data["link"].is_null()) 
+        ? std::make_optional(data["link"].get<std::string>()) 
+        : std::nullopt;
+        
+        std::optional<int> mRef;
+        
+        MessageFormat message {
+            .picture = picture,
+            .displayName = displayName,
+            .serverID = sid,
+            .content = content,
+            .messageRef = mRef,
+            .link = link
+        };
 
-            json jdata;
-            jdata["serverID"] = sid;
-            jdata["displayName"] = displayName;
-            jdata["picture"] = picture;
-            jdata["content"] = content;
-            jdata["id"] = std::stoi(message_id);
-            jdata["messageRef"] = mRef ? json(*mRef) : json(nullptr);
-            jdata["timestamp"] = time;
-            jdata["link"] = link ? json(*link) : json(nullptr);
+        // The io thread moves on; broadcast and ack follow the commit on this session's strand
+        auto self = session.shared_from_this();
+        create_message(user_id, message, [=](json message_object) {
+            self->defer([=, message_object = std::move(message_object)] {
+                if (!message_object.value("success", false)) {
+                    self->send(json{{"event", "error"}, {"data", {{"message", message_object.value("error", "Message not saved")}}}});
+                    return;
+                }
 
-            json msg;
-            msg["event"] = "message";
-            msg["data"] = jdata;
+                std::string message_id = message_object.value("id", "");
+                std::string time = message_object.value("timestamp", "");
+
+                // discord_sendM(displayname, text);
+
+                // Built in place; the event is serialized once inside broadcast()
+                json msg;
+                msg["event"] = "message";
+                json& jdata = msg["data"];
+                jdata["serverID"] = sid;
+                jdata["displayName"] = displayName;
+                jdata["picture"] = picture;
+                jdata["content"] = content;
+                jdata["id"] = std::stoi(message_id);
+                jdata["messageRef"] = mRef ? json(*mRef) : json(nullptr);
+                jdata["timestamp"] = std::move(time);
+                jdata["link"] = link ? json(*link) : json(nullptr);
+
+                LOG_DEBUG("message broadcast", {"server", sid}, {"id", message_id}, {"content", content});
+
+                g_sessions.broadcast(sid, msg); // 🔥 broadcast to the server's subscribers
+
+                // Respond back to sender as acknowledgment
+                self->send(json{
+                    {"event", "ack"},
+                    {"data", {{"message", content}}}
+                });
+            });
+        });
+
+        return json(); // answered from the commit callback
+    };
 
+    eventHandlers["delete_message"] = [](WebSocketSession&, const json& data) {
+        std::string message_id = data.value("message_id", "");
 
-            std::cout << "[Broadcast] " << content << "\n";
+        json deleted = delete_message(std::stoi(message_id));
+        std::string sid = deleted.value("server_id", "");
 
-            g_sessions.broadcast(msg); // 🔥 broadcast to everyone
+        json msg;
+        msg["event"] = "message_deleted";
+        json& jdata = msg["data"];
+        jdata["success"] = true;
+        jdata["message"] = "Message deleted from chat";
+        jdata["id"] = std::stoi(message_id);
+        jdata["serverID"] = sid;
 
+        g_sessions.broadcast(sid, msg);
 
-            // Respond back to sender as acknowledgment
-            return json{
-                {"event", "ack"},
-                {"data", {{"message", content}}}
-            };
+        return json{
+            {"event", "ack"},
+            {"data", {{"message", "text"}}}
         };
+    };
 
-        eventHandlers["delete_message"] = [&](const json& data) {
-            std::string message_id = data.value("message_id", "");
+    eventHandlers["edit_message"] = [](WebSocketSession&, const json& data) {
+        std::string message_id = data.value("message_id", "");
+        std::string content = data.value("content", "");
 
-            delete_message(std::stoi(message_id));
+        json edited = edit_message(std::stoi(message_id), content);
+        std::string sid = edited.value("server_id", "");
 
-            json msg = {
-                {"event", "message_deleted"},
-                {"data", {
-                        {"success", true},
-                        {"message", "Message deleted from chat"},
-                        {"id", std::stoi(message_id)}
-                    }
-                }
-            };
-
-            std::cout << msg.value("message", "");
+        json msg;
+        msg["event"] = "message_edited";
+        json& jdata = msg["data"];
+        jdata["success"] = true;
+        jdata["message"] = "Message edited";
+        jdata["id"] = std::stoi(message_id);
+        jdata["content"] = content;
+        jdata["serverID"] = sid;
 
-            g_sessions.broadcast(msg);
+        g_sessions.broadcast(sid, msg);
 
-            return json{
-                {"event", "ack"},
-                {"data", {{"message", "text"}}}
-            };
+        return json{
+            {"event", "ack"},
+            {"data", {{"message", "text"}}}
         };
+    };
 
-        eventHandlers["edit_message"] = [&](const json& data) {
-            std::string message_id = data.value("message_id", "");
-            std::string content = data.value("content", "");
-
-            edit_message(std::stoi(message_id), content);
+    eventHandlers["reply_to_message"] = [](WebSocketSession& session, const json& data) {
+        std::string messageRef = data.value("ref_id", "");
+        std::string content = data.value("content", "");
+        std::string sid = data.value("sid", "");
+        
+        const std::string& user_id = session.user_id;
+
+        std::optional<std::string> link = (data.contains("link") && !data["link"].is_null()) 
+        ? std::make_optional(data["link"].get<std::string>()) 
+        : std::nullopt;
+
+        json user = get_user_all(user_id);
+        std::string picture = user.value("picture", "");
+        std::string displayName = user.value("displayName", "");
+
+        MessageFormat message {
+            .picture = picture,
+            .displayName = displayName,
+            .serverID = sid,
+            .content = content,
+            .messageRef = std::stoi(messageRef),
+            .link = link,
+        };
 
-            json msg = {
-                {"event", "message_edited"},
-                {"data", {
-                        {"success", true},
-                        {"message", "Message edited"},
-                        {"id", std::stoi(message_id)},
-                        {"content", content}
-                    }
+        auto self = session.shared_from_this();
+        create_message(user_id, message, [=](json message_object) {
+            self->defer([=, message_object = std::move(message_object)] {
+                if (!message_object.value("success", false)) {
+                    self->send(json{{"event", "error"}, {"data", {{"message", message_object.value("error", "Message not saved")}}}});
+                    return;
                 }
-            };
 
-            std::cout << msg.value("message", "");
+                std::string message_id = message_object.value("id", "");
+                std::string time = message_object.value("timestamp", "");
+
+                json msg;
+                msg["event"] = "message";
+                json& jdata = msg["data"];
+                jdata["serverID"] = sid;
+                jdata["displayName"] = displayName;
+                jdata["picture"] = picture;
+                jdata["content"] = content;
+                jdata["id"] = std::stoi(message_id);
+                jdata["messageRef"] = messageRef;
+                jdata["timestamp"] = std::move(time);
+                jdata["link"] = link ? json(*link) : json(nullptr);
+
+                g_sessions.broadcast(sid, msg);
+
+                self->send(json{
+                    {"event", "ack"},
+                    {"data", {{"message", "text"}}}
+                });
+            });
+        });
+
+        return json(); // answered from the commit callback
+    };
 
-            g_sessions.broadcast(msg);
+    eventHandlers["ping"] = [](WebSocketSession&, const json&) {
+        return json{{"event", "pong"}, {"data", {{"time", time(nullptr)}}}};
+    };
 
-            return json{
-                {"event", "ack"},
-                {"data", {{"message", "text"}}}
-            };
-        };
+    eventHandlers["schedule_notification"] = [](WebSocketSession& session, const json& data) {
+        std::string content = data.value("content", "");
+        std::string serverID = data.value("sid", "");
 
-        eventHandlers["reply_to_message"] = [&](const json& data) {
-            std::string messageRef = data.value("ref_id", "");
-            std::string content = data.value("content", "");
-            std::string sid = data.value("sid", "");
-            std::string token = data.value("token", "");
-            
-            std::string user_id = decode_token(token);
+        const std::string& user_id = session.user_id;
 
-            std::optional<std::string> link = (data.contains("link") && !data["link"].is_null()) 
-            ? std::make_optional(data["link"].get<std::string>()) 
-            : std::nullopt;
+        json user = get_user_all(user_id);
 
-            MessageFormat message {
-                .serverID = sid,
-                .content = content,
-                .messageRef = std::stoi(messageRef),
-                .link = link,
-            };
+        std::string displayname = user.value("displayName", "");
+        std::string pfp = user.value("picture", "");
+        std::string username = user.value("username", "");
 
-            json message_object = create_message(user_id, message);
-            std::string message_id = message_object.value("id", "");
+        json notification;
+        notification["event"] = "notification";
+        json& sender = notification["data"]["sender"];
+        sender["token"] = user_id;
+        sender["displayName"] = std::move(displayname);
+        sender["message"] = std::move(content);
+        sender["picture"] = std::move(pfp);
+        notification["data"]["serverID"] = serverID;
 
-            json user = get_user_all(user_id);
-            std::string picture = user.value("picture", "");
-            std::string displayName = user.value("displayName", "");
-            std::string time = message_object.value("timestamp", "");
+        g_sessions.broadcast(serverID, notification);
 
-            json jdata;
-            jdata["serverID"] = sid;
-            jdata["displayName"] = displayName;
-            jdata["picture"] = picture;
-            jdata["content"] = content;
-            jdata["id"] = std::stoi(message_id);
-            jdata["messageRef"] = messageRef;
-            jdata["timestamp"] = time;
-            jdata["link"] = link ? json(*link) : json(nullptr);
+        return json{
+            {"event", "ack"},
+            {"data", {{"message", "text"}}}
+        };
+    };
 
-            json msg;
-            msg["event"] = "message";
-            msg["data"] = jdata;
+    // {"image": <bytes>, "name": "me.png"}; raw bytes need a binary protocol
+    eventHandlers["upload_profile"] = [](WebSocketSession& session, const json& data) {
+        static const std::unordered_set<std::string> extensions{"jpg", "jpeg", "png", "gif", "webp"};
 
-            std::cout << msg.value("message", "");
+        if (!data.contains("image") || !data["image"].is_binary()) {
+            return json{{"event", "error"}, {"data", {{"message", "upload_profile needs image bytes over atlas.msgpack or atlas.cbor"}}}};
+        }
+        const json::binary_t& image = data["image"].get_binary();
+
+        // Stored under the user's id; the client's name only picks the extension
+        std::string name = data.value("name", "");
+        std::string extension = name.substr(name.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (name.find('.') == std::string::npos || !extensions.contains(extension)) {
+            extension = "jpg";
+        }
 
-            g_sessions.broadcast(msg);
+        save_profile_image(session.user_id, reinterpret_cast<const char*>(image.data()), image.size(), session.user_id + "." + extension);
 
-            return json{
-                {"event", "ack"},
-                {"data", {{"message", "text"}}}
-            };
-        };
+        return json{{"event", "upload_profile_ack"}, {"data", {{"status", "success"}, {"bytes", image.size()}}}};
+    };
 
-        eventHandlers["ping"] = [&](const json&) {
-            return json{{"event", "pong"}, {"data", {{"time", time(nullptr)}}}};
+    eventHandlers["get_user"] = [](WebSocketSession& session, const json&) {
+        const std::string& user_id = session.user_id;
+        json user = get_user_all(user_id);
+ 
+        return json{
+            {"event", "return_user"},
+            {"data", user},
         };
+    };
 
-        eventHandlers["schedule_notification"] = [&](const json& data) {
-            http::response<http::string_body> res{http::status::unauthorized, req.version()};
+    eventHandlers["update_status"] = [](WebSocketSession& session, const json& data) {
+        std::string status = data.value("status", "");;
 
-            std::string content = data.value("content", "");
-            std::string token = data.value("token", "");
-            std::string serverID = data.value("sid", "");
+        if (!Presence::valid(status)) {
+            return json{{"event", "error"}, {"data", {{"message", "Unknown status: " + status}}}};
+        }
 
-            std::string user_id = decode_token(token);
+        // Peers hear about it on the next presence tick, if it still differs then
+        presence().set(session.user_id, status);
 
-            json user = get_user_all(user_id);
+        return json{
+            {"event", "ack"},
+            {"data", {{"message", "text"}}}
+        };
+    };
 
-            std::string displayname = user.value("displayName", "");
-            std::string pfp = user.value("picture", "");
-            std::string username = user.value("username", "");
+    eventHandlers["verify_invite"] = [](WebSocketSession&, const json& data) {
+        std::string code = data.value("code", "");
+        json response = verify_invite(code)["invite"];
 
-            json notification = {
-                {"event", "notification"},
+        if (response.contains("failed")) {
+            return json{
+                {"event", "invite"},
                 {"data", {
-                    {"sender", {
-                        {"token", user_id},
-                        {"displayName", displayname},
-                        {"message", content},
-                        {"picture", pfp}
-                    }},
-                    {"serverID", serverID}
+                    {"failed", "The provided server may or may not exist."},
                 }}
             };
-
-            g_sessions.broadcast(notification);
+        } else {
+            std::string user_id = response.value("issued_by", "");
+            std::string sid = response.value("sid", "");
+            std::string username = get_user_all(user_id).value("username", "");
+            std::string server_name = get_server(sid)["server"].value("server_name", "");
 
             return json{
-                {"event", "ack"},
-                {"data", {{"message", "text"}}}
+                {"event", "invite"},
+                {"data", {
+                    {"issued_by", username},
+                    {"server", {
+                        {"sid", sid},
+                        {"server_name", server_name},
+                    }}
+                }}
             };
-        };
-
-        eventHandlers["upload_profile"] = [&](const json& data) {
-            std::cout << data << "e";
+        }
+    };
 
-            return json{{"event", "pong"}, {"data", {{"time", time(nullptr)}}}};
-        };
+    eventHandlers["join_server"] = [](WebSocketSession& session, const json& data) {
 
-        eventHandlers["get_user"] = [&](const json& data) {
-            std::string token = data.value("token", "");
-            std::string user_id = decode_token(token);
-            json user = get_user_all(user_id);
- 
-            return json{
-                {"event", "return_user"},
-                {"data", user},
-            };
-        };
+        const std::string& user_id = session.user_id;
+        std::string sid = data.value("sid", "");
 
-        eventHandlers["update_status"] = [&](const json& data) {
-            std::string token = data.value("auth", "");
-            std::string status = data.value("status", "");;
-            
-            std::string user_id = decode_token(token);
+        json sres = join_server(sid, user_id);
 
-            std::string update_type = set_user_appearance_status(user_id, status);
+        if (sres.contains("server") && sres["server"].contains("serverID")) {
+            g_sessions.subscribe(session.shared_from_this(), sid);
+        }
 
-            json update = {
-                {"event", "update"},
+        if (sres.contains("error")) {
+            return json {
+                {"event", "server_response"},
                 {"data", {
-                    {"update", {
-                        {"status", update_type},
-                        {"userID", user_id}
-                    }}
+                    {"status", "failed"},
+                    {"message", "Failed to join server, don't ask why."}
                 }}
             };
+        }
+
+        return json {
+            {"event", "server_response"},
+            {"data", sres}
+        };
+    };
 
-            g_sessions.broadcast(update);
+    eventHandlers["create_server"] = [](WebSocketSession& session, const json& data) {
+        std::string serverName = data.value("server_name", "");
 
-            return json{
-                {"event", "ack"},
-                {"data", {{"message", "text"}}}
-            };
+        const std::string& user_id = session.user_id;
+
+        json server = create_server(serverName, user_id);
+
+        if (server.value("status", 0) == 200) {
+            g_sessions.subscribe(session.shared_from_this(), server["server"].value("serverID", ""));
+        }
+
+        return json{
+            {"event", "creation_response"},
+            {"data", server}
         };
 
-        eventHandlers["verify_invite"] = [&](const json& data) {
-            std::string code = data.value("code", "");
-            json response = verify_invite(code)["invite"];
+    };
 
-            if (response.contains("failed")) {
-                return json{
-                    {"event", "invite"},
-                    {"data", {
-                        {"failed", "The provided server may or may not exist."},
-                    }}
-                };
-            } else {
-                std::string user_id = response.value("issued_by", "");
-                std::string sid = response.value("sid", "");
-                std::string username = get_user_all(user_id).value("username", "");
-                std::string server_name = get_server(sid)["server"].value("server_name", "");
-    
-                return json{
-                    {"event", "invite"},
-                    {"data", {
-                        {"issued_by", username},
-                        {"server", {
-                            {"sid", sid},
-                            {"server_name", server_name},
-                        }}
-                    }}
-                };
+    // Latency and escaped exceptions per event, registered once per key
+    for (auto& [event, handler] : eventHandlers) {
+        Histogram& latency = metrics().histogram("atlas_ws_event_duration_seconds", "WebSocket event handler latency", label("event", event));
+        Counter& errors = metrics().counter("atlas_ws_event_exceptions_total", "Exceptions thrown by WebSocket event handlers", label("event", event));
+
+        handler = [inner = std::move(handler), &latency, &errors](WebSocketSession& session, const json& data) {
+            ScopedTimer timer(latency);
+            try {
+                return inner(session, data);
+            } catch (...) {
+                errors.inc();
+                throw;
             }
         };
+    }
 
-        eventHandlers["join_server"] = [&](const json& data) {
-            http::response<http::string_body> res{http::status::unauthorized, req.version()};
-            std::string token = data.value("token", "");
+    return eventHandlers;
+}
 
-            auto decoded = jwt::decode(token);
-            jwt::verify().allow_algorithm(jwt::algorithm::hs256{secret}).verify(decoded);
-            
-            std::string user_id = decoded.get_subject();
-            std::string sid = data.value("sid", "");
+//------------------------------------------------------------
+// Handle WebSocket connections
+//------------------------------------------------------------
+void WebSocketSession::run(http::request<http::string_body> req)
+{
+    // The websocket stream runs its own ping/idle timeouts
+    beast::get_lowest_layer(ws).expires_never();
+    ws.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+
+    upgrade_token = request_token(req);
+
+    // Clients opt into a binary envelope by offering atlas.msgpack or atlas.cbor
+    if (req.count(http::field::sec_websocket_protocol)) {
+        auto offered = req[http::field::sec_websocket_protocol];
+        if (auto negotiated = ws_negotiate({offered.data(), offered.size()})) {
+            codec = *negotiated;
+
+            const char* protocol = ws_protocol_name(codec);
+            ws.set_option(websocket::stream_base::decorator([protocol](websocket::response_type& res) {
+                res.set(http::field::sec_websocket_protocol, protocol);
+            }));
+        }
+    }
+    ws.text(codec == WsCodec::json);
 
-            json sres = join_server(sid, user_id);
+    ws.async_accept(req, beast::bind_front_handler(&WebSocketSession::on_accept, shared_from_this()));
+}
 
-            if (sres.contains("error")) {
-                return json {
-                    {"event", "server_response"},
-                    {"data", {
-                        {"status", "failed"},
-                        {"message", "Failed to join server, don't ask why."}
-                    }}
-                };
-            }
+void WebSocketSession::on_accept(beast::error_code ec)
+{
+    if (ec) {
+        LOG_WARN("ws accept failed", {"error", ec.message()});
+        return;
+    }
 
-            return json {
-                {"event", "server_response"},
-                {"data", sres}
-            };
-        };
+    g_sessions.add(shared_from_this());
 
-        eventHandlers["create_server"] = [&](const json& data) {
-            std::string token = data.value("auth", "");
-            std::string serverName = data.value("server_name", "");
+    static Counter& accepted_json = metrics().counter("atlas_ws_accepted_total", "WebSocket sessions accepted", label("codec", "json"));
+    static Counter& accepted_msgpack = metrics().counter("atlas_ws_accepted_total", "WebSocket sessions accepted", label("codec", "msgpack"));
+    static Counter& accepted_cbor = metrics().counter("atlas_ws_accepted_total", "WebSocket sessions accepted", label("codec", "cbor"));
+    (codec == WsCodec::msgpack ? accepted_msgpack : codec == WsCodec::cbor ? accepted_cbor : accepted_json).inc();
 
-            auto decoded = jwt::decode(token);
-            jwt::verify().allow_algorithm(jwt::algorithm::hs256{secret}).verify(decoded);
-            
-            std::string user_id = decoded.get_subject();
-            json server = create_server(serverName, user_id);
+    LOG_INFO("ws client connected", {"sessions", g_sessions.count()}, {"protocol", ws_protocol_name(codec)});
 
-            return json{
-                {"event", "creation_response"},
-                {"data", server}
-            };
+    // Without upgrade credentials the client authenticates with its first frame
+    if (!upgrade_token.empty()) {
+        try {
+            authenticate(upgrade_token);
+        } catch (const std::exception& e) {
+            json err = {{"event", "error"}, {"data", {{"message", std::string("Authentication failed: ") + e.what()}}}};
+            send(err);
+        }
+        upgrade_token.clear();
+    }
 
-        };
+    do_read();
+}
+
+void WebSocketSession::do_read()
+{
+    ws.async_read(buffer, beast::bind_front_handler(&WebSocketSession::on_read, shared_from_this()));
+}
+
+void WebSocketSession::on_read(beast::error_code ec, std::size_t bytes)
+{
+    static Counter& received = metrics().counter("atlas_ws_received_bytes_total", "WebSocket payload bytes received");
+    received.inc(bytes);
 
-        // Main receive loop
-        for (;;) {
-            beast::flat_buffer buffer;
-            ws->read(buffer);
-
-            if (ws->got_text()) {
-                // JSON text message
-                std::string message = beast::buffers_to_string(buffer.data());
-                std::cout << "[WebSocket] Received: " << message << "\n";
-
-                json msg = json::parse(message);
-                std::string event = msg.value("event", "");
-                json data = msg.value("data", json::object());
-
-                if (eventHandlers.contains(event)) {
-                    json response = eventHandlers[event](data);
-                    ws->text(true);
-                    ws->write(net::buffer(response.dump()));
-                } else {
-                    json err = {{"event", "error"}, {"data", {{"message", "Unknown event: " + event}}}};
-                    ws->text(true);
-                    ws->write(net::buffer(err.dump()));
+    if (ec) {
+        if (ec != websocket::error::closed) {
+            LOG_WARN("ws read failed", {"user", user_id}, {"error", ec.message()});
+        }
+        g_sessions.remove(shared_from_this());
+        return;
+    }
+
+    static const std::map<std::string, WsEventHandler> eventHandlers = make_event_handlers();
+    static const std::unordered_set<std::string> publicEvents{"auth", "ping", "verify_invite"};
+
+    // Handlers that may wait on the database or disk; they run on the worker pool
+    static const std::unordered_set<std::string> blockingEvents{
+        "delete_message", "edit_message", "get_user", "verify_invite", "join_server", "create_server", "upload_profile"
+    };
+
+    std::string_view frame{static_cast<const char*>(buffer.data().data()), buffer.size()};
+
+    if (!ws.got_text() && codec == WsCodec::json) {
+        // Raw binary on a JSON socket: the untyped profile upload older clients send
+        LOG_DEBUG("ws binary frame", {"user", user_id}, {"bytes", frame.size()});
+
+        try {
+            if (user_id.empty()) {
+                throw std::runtime_error("Not authenticated");
+            }
+            save_profile_image(user_id, frame.data(), frame.size(), "profile.jpg");
+            send(json{{"event", "upload_profile_ack"}, {"data", {{"status", "success"}}}});
+        } catch (const std::exception& e) {
+            send(json{{"event", "error"}, {"data", {{"message", e.what()}}}});
+        }
+    } else {
+        // Event envelope; text frames are JSON whatever was negotiated
+        if (ws.got_text()) {
+            LOG_DEBUG("ws frame", {"user", user_id}, {"payload", frame});
+        } else {
+            LOG_DEBUG("ws frame", {"user", user_id}, {"bytes", frame.size()});
+        }
+
+        try {
+            json msg = ws_decode(frame, ws.got_text() ? WsCodec::json : codec);
+            std::string event = msg.value("event", "");
+            json data = msg.value("data", json::object());
+
+            // First-frame authentication: an explicit "auth" event, or the token
+            // older clients attach to every event. Later tokens are ignored.
+            if (user_id.empty()) {
+                std::string token = data.value("token", data.value("auth", ""));
+                if (!token.empty()) {
+                    authenticate(token);
                 }
+            }
+
+            auto it = eventHandlers.find(event);
+            if (it != eventHandlers.end() && user_id.empty() && !publicEvents.contains(event)) {
+                json err = {{"event", "error"}, {"data", {{"message", "Not authenticated"}}}};
+                send(err);
+            } else if (it != eventHandlers.end() && blockingEvents.contains(event)) {
+                buffer.consume(buffer.size());
+                return run_blocking(it->second, std::move(data));
+            } else if (it != eventHandlers.end()) {
+                // null: the handler replies later, from defer()
+                json response = it->second(*this, data);
+                if (!response.is_null()) send(response);
             } else {
-                handle_images(ws, buffer, "profile.jpg");
-                // Binary data received → treat as profile image
-                // std::cout << "[WebSocket] Received binary data of size: " << buffer.size() << "\n";
-                // std::string base = "../uploads/users/photos/";
-                // std::string fname;
+                json err = {{"event", "error"}, {"data", {{"message", "Unknown event: " + event}}}};
+                send(err);
+            }
+        } catch (const std::exception& e) {
+            LOG_WARN("ws event failed", {"user", user_id}, {"error", e.what()});
+            json err = {{"event", "error"}, {"data", {{"message", e.what()}}}};
+            send(err);
+        }
+    }
 
-                // std::string message = beast::buffers_to_string(buffer.data());
+    buffer.consume(buffer.size());
+    do_read();
+}
 
-                // // Save the uploaded file
-                // std::ofstream out("../uploads/users/photos/profile.jpg", std::ios::binary);
-                // out.write(static_cast<const char*>(buffer.data().data()), buffer.size());
-                // out.close();
+void WebSocketSession::send(const json& event)
+{
+    send(std::make_shared<const std::string>(ws_encode(event, codec)));
+}
 
-                // // Send acknowledgment back to client
-                // json ack = {{"event", "upload_profile_ack"}, {"data", {{"status", "success"}}}};
-                // ws->text(true);
-                // ws->write(net::buffer(ack.dump()));
+void WebSocketSession::send(std::shared_ptr<const std::string> payload)
+{
+    net::post(ws.get_executor(), [self = shared_from_this(), payload = std::move(payload)]() mutable {
+        if (self->evicted) return;
 
-                // std::cout << "[Server] Profile image saved!\n";
-            }
+        if (self->queue.size() >= kWsMaxQueuedFrames || self->queued_bytes + payload->size() > kWsMaxQueuedBytes) {
+            return self->evict();
         }
 
+        self->queued_bytes += payload->size();
+        self->queue.push_back(std::move(payload));
 
-    } catch (const std::exception& e) {
-        std::cerr << "[WebSocket] Error: " << e.what() << "\n";
+        // Only one async_write may be in flight at a time
+        if (self->queue.size() == 1) {
+            self->do_write();
+        }
+    });
+}
+
+void WebSocketSession::defer(std::function<void()> fn)
+{
+    net::post(ws.get_executor(), [self = shared_from_this(), fn = std::move(fn)] {
+        try {
+            fn();
+        } catch (const std::exception& e) {
+            LOG_WARN("ws deferred reply failed", {"user", self->user_id}, {"error", e.what()});
+            self->send(json{{"event", "error"}, {"data", {{"message", e.what()}}}});
+        }
+    });
+}
+
+// Reading pauses until the worker answers, so replies keep the order the
+// client sent its events in
+void WebSocketSession::run_blocking(const WsEventHandler& handler, json data)
+{
+    auto self = shared_from_this();
+
+    bool queued = worker_pool().try_submit([self, &handler, data = std::move(data)] {
+        json response;
+        try {
+            response = handler(*self, data);
+        } catch (const std::exception& e) {
+            LOG_WARN("ws event failed", {"user", self->user_id}, {"error", e.what()});
+            response = {{"event", "error"}, {"data", {{"message", e.what()}}}};
+        }
+
+        self->defer([self, response = std::move(response)] {
+            if (!response.is_null()) self->send(response);
+            self->do_read();
+        });
+    });
+
+    if (!queued) {
+        send(json{{"event", "error"}, {"data", {{"message", "Server busy, try again shortly"}}}});
+        do_read();
+    }
+}
+
+void WebSocketSession::do_write()
+{
+    ws.async_write(net::buffer(*queue.front()), beast::bind_front_handler(&WebSocketSession::on_write, shared_from_this()));
+}
+
+void WebSocketSession::on_write(beast::error_code ec, std::size_t bytes)
+{
+    static Counter& sent = metrics().counter("atlas_ws_sent_bytes_total", "WebSocket payload bytes sent");
+    sent.inc(bytes);
+
+    if (ec) {
+        // The pending read fails too and unregisters the session
+        queue.clear();
+        queued_bytes = 0;
+        return;
+    }
+
+    queued_bytes -= queue.front()->size();
+    queue.pop_front();
+
+    if (!queue.empty()) {
+        do_write();
     }
 }
 
+void WebSocketSession::evict()
+{
+    LOG_WARN("ws dropping slow client", {"user", user_id}, {"frames", queue.size()}, {"bytes", queued_bytes});
+
+    evicted = true;
+
+    // The front frame may still be in flight; its buffer has to live until on_write
+    if (!queue.empty()) {
+        queue.erase(queue.begin() + 1, queue.end());
+        queued_bytes = queue.front()->size();
+    }
+
+    // Closing the socket fails the pending read, which unregisters the session
+    beast::get_lowest_layer(ws).close();
+}
+
+void handle_websocket(tcp::socket socket, http::request<http::string_body> req)
+{
+    std::make_shared<WebSocketSession>(std::move(socket))->run(std::move(req));
+}
+
 //------------------------------------------------------------
 // Handle a single session (HTTP or WS)
 //------------------------------------------------------------
-void do_session(tcp::socket socket,
-                const std::map<std::string, HttpRoute>& routes)
+// Persistent HTTP/1.1 connections: idle sockets are dropped after this long,
+// and a connection is closed once it has served this many requests.
+constexpr auto kHttpIdleTimeout = std::chrono::seconds(30);
+constexpr unsigned kHttpMaxRequestsPerConnection = 100;
+
+// Routes that run argon2. They execute on the hash pool instead of the network
+// threads and are turned away with 503 when its queue is full.
+const std::unordered_set<std::string> kHashingRoutes{"/api/login", "/api/create"};
+
+// Routes that only read in-process state and stay on the network threads;
+// every other route may block on the database and runs on the worker pool
+const std::unordered_set<std::string> kInlineRoutes{"/api/stats", "/api/metrics"};
+
+http::response<http::string_body> busy_response(const http::request<http::string_body>& req)
 {
-    try {
-        beast::flat_buffer buffer;
-        http::request<http::string_body> req;
-        http::read(socket, buffer, req);
+    http::response<http::string_body> res{http::status::service_unavailable, req.version()};
+    json response_body;
+    response_body["error"] = "Server busy, try again shortly";
+    response_body["status"] = 503;
+
+    res.set(http::field::server, "Boost.Beast");
+    res.set(http::field::content_type, "application/json");
+    res.set(http::field::retry_after, "1");
+    res.set(http::field::access_control_allow_origin, "*");
+    res.set(http::field::access_control_allow_credentials, "true");
+    res.body() = response_body.dump();
+    res.prepare_payload();
+
+    return res;
+}
+
+class HttpSession : public std::enable_shared_from_this<HttpSession> {
+public:
+    HttpSession(tcp::socket&& socket, const Router& routes)
+        : stream(std::move(socket)), routes(routes) {}
+
+    void run() {
+        net::dispatch(stream.get_executor(), beast::bind_front_handler(&HttpSession::do_read, shared_from_this()));
+    }
+
+private:
+    beast::tcp_stream stream;
+    beast::flat_buffer buffer; // persists across requests so pipelined bytes are kept
+    http::request<http::string_body> req;
+    http::response<http::string_body> res; // must outlive async_write
+    const Router& routes;
+    unsigned served = 0;
+
+    void do_read() {
+        req = {};
+        stream.expires_after(kHttpIdleTimeout);
+
+        // Pipelined requests already sitting in the buffer are parsed without touching the socket
+        http::async_read(stream, buffer, req, beast::bind_front_handler(&HttpSession::on_read, shared_from_this()));
+    }
+
+    void on_read(beast::error_code ec, std::size_t bytes) {
+        static Counter& received = metrics().counter("atlas_http_received_bytes_total", "HTTP bytes received");
+        received.inc(bytes);
+
+        if (ec) {
+            if (ec != http::error::end_of_stream && ec != beast::error::timeout) {
+                LOG_WARN("http read failed", {"error", ec.message()});
+            }
+            return do_close();
+        }
 
         if (websocket::is_upgrade(req)) {
-            handle_websocket(std::move(socket), req);
-        } else {
-            handle_http(socket, req, routes);
+            handle_websocket(stream.release_socket(), std::move(req));
+            return;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "[Session] Error: " << e.what() << "\n";
+
+        std::string path{route_path({req.target().data(), req.target().size()})};
+        if (req.method() != http::verb::options && kHashingRoutes.contains(path)) {
+            return offload(hash_pool());
+        }
+        if (req.method() != http::verb::options && !kInlineRoutes.contains(path)) {
+            return offload(worker_pool());
+        }
+
+        try {
+            res = handle_http(req, routes);
+        } catch (const std::exception& e) {
+            LOG_ERROR("http request failed", {"error", e.what()});
+            return do_close();
+        }
+
+        write_response();
+    }
+
+    // No read is pending while the task runs, so the worker may use req freely;
+    // the finished response is handed back to the strand to be written.
+    template <typename Pool>
+    void offload(Pool& pool) {
+        auto self = shared_from_this();
+
+        bool queued = pool.try_submit([self] {
+            try {
+                auto response = handle_http(self->req, self->routes);
+
+                net::post(self->stream.get_executor(), [self, response = std::move(response)]() mutable {
+                    self->res = std::move(response);
+                    self->write_response();
+                });
+            } catch (const std::exception& e) {
+                LOG_ERROR("http request failed", {"error", e.what()});
+                net::post(self->stream.get_executor(), [self] { self->do_close(); });
+            }
+        });
+
+        if (!queued) {
+            res = busy_response(req);
+            write_response();
+        }
+    }
+
+    void write_response() {
+        ++served;
+        res.version(req.version());
+        res.keep_alive(req.keep_alive() && served < kHttpMaxRequestsPerConnection);
+
+        // The request may have waited on a worker; give the write a fresh deadline
+        stream.expires_after(kHttpIdleTimeout);
+        http::async_write(stream, res, beast::bind_front_handler(&HttpSession::on_write, shared_from_this(), res.need_eof()));
     }
-}
+
+    void on_write(bool close, beast::error_code ec, std::size_t bytes) {
+        static Counter& sent = metrics().counter("atlas_http_sent_bytes_total", "HTTP bytes sent");
+        sent.inc(bytes);
+
+        if (ec) {
+            LOG_WARN("http write failed", {"error", ec.message()});
+            return do_close();
+        }
+
+        if (close) {
+            return do_close();
+        }
+
+        do_read();
+    }
+
+    void do_close() {
+        beast::error_code ec;
+        stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+    }
+};
+
+//------------------------------------------------------------
+// Accepts connections and hands each one its own strand
+//------------------------------------------------------------
+class Listener : public std::enable_shared_from_this<Listener> {
+public:
+    Listener(net::io_context& ioc, tcp::endpoint endpoint, const Router& routes)
+        : ioc(ioc), acceptor(ioc), routes(routes), retry(ioc)
+    {
+        acceptor.open(endpoint.protocol());
+        acceptor.set_option(net::socket_base::reuse_address(true));
+        acceptor.bind(endpoint);
+        acceptor.listen(net::socket_base::max_listen_connections);
+    }
+
+    void run() {
+        do_accept();
+    }
+
+private:
+    net::io_context& ioc;
+    tcp::acceptor acceptor;
+    const Router& routes;
+
+    // Accept errors such as EMFILE/ENFILE persist until connections close, so
+    // re-arming at once would spin; wait, doubling up to a second per failure
+    net::steady_timer retry;
+    std::chrono::milliseconds backoff{0};
+
+    void do_accept() {
+        acceptor.async_accept(net::make_strand(ioc), beast::bind_front_handler(&Listener::on_accept, shared_from_this()));
+    }
+
+    void on_accept(beast::error_code ec, tcp::socket socket) {
+        if (ec == net::error::operation_aborted || !acceptor.is_open()) {
+            return;
+        }
+
+        if (!ec) {
+            backoff = std::chrono::milliseconds(0);
+            std::make_shared<HttpSession>(std::move(socket), routes)->run();
+            do_accept();
+            return;
+        }
+
+        backoff = std::clamp(backoff * 2, std::chrono::milliseconds(10), std::chrono::milliseconds(1000));
+        LOG_WARN("accept failed", {"error", ec.message()}, {"retry_ms", backoff.count()});
+
+        retry.expires_after(backoff);
+        retry.async_wait([self = shared_from_this()](beast::error_code wait_ec) {
+            if (!wait_ec) self->do_accept();
+        });
+    }
+};
 
 json get_user(const std::string& username);
 
 void create_account(const std::string& username, const std::string& displayName, const std::string& password, const std::string& custom_status, const std::string& bio);
 bool login_user(std::string& username, std::string& password);
-json get_messages(const std::string serverID);
+void get_messages(const std::string serverID, const MessageCursor& cursor, JsonWriter& out);
 void update_account(const std::string& username, const std::string& displayname, const std::string& profile_picture, const std::string& custom_status, const std::string& bio, const std::string& UUID);
-json user_get_all_servers(const std::string& UUID);
 
 int ping_server() {        
     try {
         const std::string host = "discord.com";
         const std::string port = "443";
-        std::string target = cenv.find_token("hooks", "webhook_key");
+        std::string target = atlas_cenv().find_token("hooks", "webhook_key");
             
         int version = 11; // HTTP/1.1
 
@@ -782,11 +1433,20 @@ json server_get_all_users(const std::string server_id);
 // Main function
 //------------------------------------------------------------
 int main(int argc, char* argv[]) {
+    atlas_log::init();
+
     if (argc > 1 && std::string(argv[1]) == "--notify") {
         ping_server();
     }
 
-    std::map<std::string, HttpRoute> routes;
+    // --storage memory runs without Postgres; otherwise [storage] backend in cenv
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--storage") {
+            use_storage(argv[i + 1]);
+        }
+    }
+
+    Router routes;
 
     // Root endpoint
     // routes["/"] = [](const http::request<http::string_body>& req) {
@@ -813,7 +1473,7 @@ int main(int argc, char* argv[]) {
     // Login endpoint
     // Within your main function, replacing the current routes["/login"] definition:
 
-    routes["/api/login"] = [](const http::request<http::string_body>& req) {
+    routes.post("/api/login", [](const http::request<http::string_body>& req) {
         http::response<http::string_body> res{http::status::ok, req.version()};
         res.set(http::field::server, "Boost.Beast");
         res.set(http::field::content_type, "application/json");
@@ -849,7 +1509,7 @@ int main(int argc, char* argv[]) {
                     .set_subject(user["user_id"])
                     .set_issued_at(std::chrono::system_clock::now())
                     .set_expires_at(expiry_time) // 🔥 FIXED: 1 week expiry (matches cookie max-age)
-                    .sign(jwt::algorithm::hs256{secret}); 
+                    .sign(jwt::algorithm::hs256{jwt_secret()}); 
 
                 // std::string cookie_value = "token=" + token + 
                 //                         "; Path=/; HttpOnly; Max-Age=604800";
@@ -885,9 +1545,9 @@ int main(int argc, char* argv[]) {
         }
 
         return res;
-    };
+    });
 
-    routes["/api/logout"] = [](const http::request<http::string_body>& req) {
+    routes.post("/api/logout", [](const http::request<http::string_body>& req) {
         http::response<http::string_body> res{http::status::unauthorized, req.version()};
         json response_body;
         auto body = json::parse(req.body());
@@ -908,9 +1568,9 @@ int main(int argc, char* argv[]) {
         res.prepare_payload();
 
         return res;
-    };
+    });
 
-    routes["/api/messages_get"] = [](const http::request<http::string_body>& req) {
+    routes.get("/api/servers/{sid}/messages", [](const http::request<http::string_body>& req, const RouteParams& params) {
         http::response<http::string_body> res{http::status::unauthorized, req.version()};
         json response_body;
 
@@ -918,37 +1578,46 @@ int main(int argc, char* argv[]) {
         res.set(http::field::access_control_allow_credentials, "true");
 
         try {
-            std::string body_str = req.body();
+            std::string serverID = params.at("sid");
 
-            if (body_str.empty()) {
-                // return json{{"error", "Empty body received"}};
-                response_body["error"] = {
-                    {"msg", "server error"}
-                };
+            // Optional keyset cursor: ?before=id or ?after=id, plus ?limit=n
+            MessageCursor cursor;
+            if (auto before = query_param(req, "before")) {
+                cursor.before = std::stoi(*before);
             }
-            
-            auto body_json = json::parse(body_str);
-            std::string serverID = body_json["sid"];
+            if (auto after = query_param(req, "after")) {
+                cursor.after = std::stoi(*after);
+            }
+            auto limit = query_param(req, "limit");
+            cursor.limit = std::clamp(limit ? std::stoi(*limit) : 50, 1, 200);
             
             res.result(http::status::ok); 
 
-            auto messages = get_messages(serverID);
-            response_body["messages"] = messages;
-            response_body["status"] = 200;
+            // History pages can be large: rows are written straight into the
+            // body rather than built up as json and dumped
+            JsonWriter out(res.body());
+            out.begin_object();
+            out.key("messages");
+            get_messages(serverID, cursor, out);
+            out.key("status").value(200);
+            out.end_object();
         } catch (const std::exception &e) {
             std::cout << "Error: " << e.what() << "\n";
+            res.result(http::status::unauthorized);
             response_body["error"] = "Internal server error.";
             response_body["what"] = e.what();
+            res.body() = response_body.dump();
         }
 
+        // Edits and deletes change old pages too, so clients revalidate via the ETag
+        res.set(http::field::cache_control, "no-cache");
         res.set(http::field::content_type, "application/json");
-        res.body() = response_body.dump();
         res.prepare_payload();
 
         return res;
-    };
+    });
 
-    routes["/api/create"] = [](const http::request<http::string_body>& req) {
+    routes.post("/api/create", [](const http::request<http::string_body>& req) {
         http::response<http::string_body> res{http::status::unauthorized, req.version()};
         json response_body;
 
@@ -978,19 +1647,19 @@ int main(int argc, char* argv[]) {
         res.prepare_payload();
 
         return res;
-    };
+    });
 
-    routes["/api/account/get"] = [](const http::request<http::string_body>& req) {
+    routes.get("/api/account", [](const http::request<http::string_body>& req) {
         // 1. Declare the response object with a default state (e.g., 401)
         http::response<http::string_body> res{http::status::unauthorized, req.version()};
         json response_body;
 
-        auto body = json::parse(req.body());
         std::string user_id = parse_bearer_token(req);
 
         // 🔥 Always include CORS headers before returning any response
         res.set(http::field::access_control_allow_origin, "http://localhost:3000"); 
         res.set(http::field::access_control_allow_credentials, "true");
+        res.set(http::field::cache_control, "private, no-cache");
 
         try {
 
@@ -1024,9 +1693,9 @@ int main(int argc, char* argv[]) {
         res.prepare_payload();
 
         return res;
-    };
+    });
 
-    routes["/api/login_status"] = [](const http::request<http::string_body>& req) {
+    routes.get("/api/login_status", [](const http::request<http::string_body>& req) {
         http::response<http::string_body> res{http::status::unauthorized, req.version()};
         json response_body;
 
@@ -1056,11 +1725,11 @@ int main(int argc, char* argv[]) {
         res.prepare_payload();
 
         return res;
-    };
+    });
 
     using ImageResponse = http::response<http::vector_body<char>>;
 
-    routes["/api/account/update"] = [](const http::request<http::string_body>& req) {
+    routes.post("/api/account/update", [](const http::request<http::string_body>& req) {
         beast::flat_buffer buffer;
         ImageResponse image_res;
         boost::beast::error_code ec;
@@ -1101,16 +1770,16 @@ int main(int argc, char* argv[]) {
         res.prepare_payload();
 
         return res;
-    };
+    });
 
-    routes["/api/servers/get"] = [](const http::request<http::string_body>& req) {
+    routes.get("/api/servers", [](const http::request<http::string_body>& req) {
         http::response<http::string_body> res{http::status::unauthorized, req.version()};
         json response_body;
-        auto body = json::parse(req.body());
         std::string user_id = parse_bearer_token(req);
 
         res.set(http::field::access_control_allow_origin, "http:://localhost:3000");
         res.set(http::field::access_control_allow_credentials, "true");
+        res.set(http::field::cache_control, "private, no-cache");
 
         try {
             // std::string user_id = get_user_id_from_cookie(req);
@@ -1133,18 +1802,14 @@ int main(int argc, char* argv[]) {
         res.prepare_payload();
 
         return res;
-    };
+    });
 
-    routes["/api/servers/userlist_get"] = [](const http::request<http::string_body>& req) {
+    routes.get("/api/servers/{sid}/users", [](const http::request<http::string_body>& req, const RouteParams& params) {
         http::response<http::string_body> res{http::status::unauthorized, req.version()};
-        auto body = json::parse(req.body());
         json response_body;
 
         try {
-            if (req.body().empty()) {
-                throw std::runtime_error("Empty body");
-            }
-            std::string server_id = body.value("serverID", "");
+            std::string server_id = params.at("sid");
 
             res.result(http::status::ok);
 
@@ -1156,22 +1821,115 @@ int main(int argc, char* argv[]) {
             std::cout << e.what() << "\n";
         }
 
+        res.set(http::field::cache_control, "no-cache");
         res.set(http::field::content_type, "application/json");
         res.body() = response_body.dump();
         res.prepare_payload();
 
         return res;
-    };
+    });
+
+    routes.get("/api/stats", [](const http::request<http::string_body>& req) {
+        http::response<http::string_body> res{http::status::ok, req.version()};
+        json response_body;
+
+        response_body["storage"] = storage().name();
+        response_body["statements"] = statement_stats();
+        response_body["token_cache"] = token_cache_stats();
+        response_body["hash_pool"] = hash_pool().stats();
+        response_body["worker_pool"] = worker_pool().stats();
+        response_body["profile_cache"] = profile_cache_stats();
+        response_body["membership"] = membership().stats();
+        response_body["message_ring"] = message_ring().stats();
+        response_body["message_writer"] = message_writer().stats();
+        response_body["presence"] = presence().stats();
+        response_body["log_dropped"] = atlas_log::dropped();
+        response_body["status"] = 200;
+
+        res.set(http::field::content_type, "application/json");
+        res.body() = response_body.dump();
+        res.prepare_payload();
+
+        return res;
+    });
+
+    routes.get("/api/metrics", [](const http::request<http::string_body>& req) {
+        http::response<http::string_body> res{http::status::ok, req.version()};
+
+        res.set(http::field::content_type, "text/plain; version=0.0.4");
+        res.body() = metrics().prometheus();
+        res.prepare_payload();
+
+        return res;
+    });
+
+    metrics().gauge("atlas_ws_sessions", "Open WebSocket sessions", [] {
+        return static_cast<double>(g_sessions.count());
+    });
+    metrics().gauge("atlas_log_dropped", "Log lines dropped on full rings", [] {
+        return static_cast<double>(atlas_log::dropped());
+    });
+    metrics().json_gauges("atlas_token_cache", [] { return token_cache_stats(); });
+    metrics().json_gauges("atlas_hash_pool", [] { return hash_pool().stats(); });
+    metrics().json_gauges("atlas_worker_pool", [] { return worker_pool().stats(); });
+    metrics().json_gauges("atlas_profile_cache", [] { return profile_cache_stats(); });
+    metrics().json_gauges("atlas_membership", [] { return membership().stats(); });
+    metrics().json_gauges("atlas_message_ring", [] { return message_ring().stats(); });
+    metrics().json_gauges("atlas_message_writer", [] { return message_writer().stats(); });
+    metrics().json_gauges("atlas_presence", [] { return presence().stats(); });
+
+    // Latency and escaped exceptions per route; wraps every entry above
+    routes.for_each([](Router::Route& route) {
+        std::string labels = label("method", std::string(http::to_string(route.method))) + "," + label("route", route.pattern);
+        Histogram& latency = metrics().histogram("atlas_http_request_duration_seconds", "HTTP route handler latency", labels);
+        Counter& errors = metrics().counter("atlas_http_exceptions_total", "Exceptions thrown by HTTP route handlers", labels);
+
+        route.handler = [inner = std::move(route.handler), &latency, &errors](const http::request<http::string_body>& req, const RouteParams& params) {
+            ScopedTimer timer(latency);
+            try {
+                return inner(req, params);
+            } catch (...) {
+                errors.inc();
+                throw;
+            }
+        };
+    });
 
     try {
-        net::io_context ioc;
-        tcp::acceptor acceptor{ioc, {tcp::v4(), 8080}};
-        std::cout << "Server running on:\n  • HTTP → http://localhost:8080/\n  • WS   → ws://localhost:8080/\n";
+        // One io_context shared by a fixed pool sized to the core count;
+        // connections no longer get a thread of their own.
+        const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        net::io_context ioc{static_cast<int>(threads)};
+
+        // Presence changes reach everyone sharing a server with the user, in the
+        // same "update" event clients already handle
+        presence().start([](const std::string& user_id, const std::string& status) {
+            json update;
+            update["event"] = "update";
+            update["data"]["update"]["status"] = status;
+            update["data"]["update"]["userID"] = user_id;
+
+            std::vector<std::string> server_ids;
+            for (const auto& server : user_get_all_servers(user_id).value("server", json::array())) {
+                server_ids.push_back(server.value("serverID", ""));
+            }
+
+            g_sessions.broadcast_to_servers(server_ids, update);
+        });
+
+        std::make_shared<Listener>(ioc, tcp::endpoint{tcp::v4(), 8080}, routes)->run();
+        std::cout << "Server running on:\n  • HTTP → http://localhost:8080/\n  • WS   → ws://localhost:8080/\n"
+                  << "  • Worker threads: " << threads << "\n";
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (unsigned i = 1; i < threads; ++i) {
+            workers.emplace_back([&ioc] { ioc.run(); });
+        }
+        ioc.run();
 
-        for (;;) {
-            tcp::socket socket{ioc};
-            acceptor.accept(socket);
-            std::thread(&do_session, std::move(socket), std::cref(routes)).detach();
+        for (auto& t : workers) {
+            t.join();
         }
     } catch (const std::exception& e) {
         std::cerr << "[Main] Error: " << e.what() << "\n";
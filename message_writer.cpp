@@ -0,0 +1,183 @@
+#include "headers/message_writer.hpp"
+#include "headers/storage.hpp"
+#include "headers/cenv.hpp"
+#include "headers/log.hpp"
+#include "headers/metrics.hpp"
+#include <algorithm>
+#include <exception>
+
+MessageWriter::MessageWriter(std::size_t writers, std::size_t max_batch, std::size_t max_queue, std::chrono::microseconds window)
+    : max_batch(std::max<std::size_t>(max_batch, 1)), max_queue(std::max<std::size_t>(max_queue, 1)), window(window) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(writers, 1); ++i) {
+        threads.emplace_back(&MessageWriter::work, this);
+    }
+}
+
+MessageWriter::~MessageWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    ready.notify_all();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void MessageWriter::submit(const std::string& user_id, const MessageFormat& message, const std::string& timestamp, Done done) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (queue.size() < max_queue) {
+            queue.push_back(Pending{user_id, message, timestamp, std::move(done)});
+            ready.notify_one();
+            return;
+        }
+    }
+
+    // Full while the database is slow or down: fail now rather than pile up
+    rejected.fetch_add(1, std::memory_order_relaxed);
+
+    Pending refused{user_id, message, timestamp, std::move(done)};
+    finish(refused, std::make_exception_ptr(std::runtime_error("Message queue full, try again shortly")), Committed{});
+}
+
+void MessageWriter::work() {
+    for (;;) {
+        std::vector<Pending> batch;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+
+            if (stopping && queue.empty()) return;
+
+            // Give concurrent senders one window to join this commit
+            ready.wait_for(lock, window, [this] { return stopping || queue.size() >= max_batch; });
+            if (queue.empty()) continue; // another writer took them
+
+            std::size_t take = std::min(queue.size(), max_batch);
+            batch.reserve(take);
+            for (std::size_t i = 0; i < take; ++i) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        commit(batch);
+    }
+}
+
+// Returns false when the database could not be reached, so a row-by-row retry
+// stops instead of waiting out the pool timeout once per row
+bool MessageWriter::commit(std::vector<Pending>& batch) {
+    static Histogram& latency = metrics().histogram("atlas_message_batch_commit_seconds", "Group-commit transaction, reserve to commit");
+
+    std::vector<int> ids;
+
+    try {
+        ScopedTimer timer(latency);
+
+        std::vector<MessageFormat> rows;
+        rows.reserve(batch.size());
+        for (const Pending& p : batch) {
+            MessageFormat row = p.message;
+            row.userID = p.user_id;
+            row.timestamp = p.timestamp;
+            rows.push_back(std::move(row));
+        }
+
+        ids = storage().insert_messages(rows);
+    } catch (const RowRejected& e) {
+        // One bad row must not fail its neighbours: retry each on its own
+        if (batch.size() > 1) {
+            LOG_WARN("message batch rejected, retrying singly", {"rows", batch.size()}, {"error", e.what()});
+            fallbacks.fetch_add(1, std::memory_order_relaxed);
+
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                std::vector<Pending> single;
+                single.push_back(std::move(batch[i]));
+                if (commit(single)) continue;
+
+                auto error = std::make_exception_ptr(std::runtime_error("Database unavailable"));
+                for (std::size_t rest = i + 1; rest < batch.size(); ++rest) {
+                    finish(batch[rest], error, Committed{});
+                }
+                failed.fetch_add(batch.size() - i - 1, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        }
+
+        finish(batch.front(), std::current_exception(), Committed{});
+        return true;
+    } catch (const std::exception& e) {
+        // Connection or pool trouble would fail every row the same way
+        LOG_WARN("message batch failed", {"rows", batch.size()}, {"error", e.what()});
+        failed.fetch_add(batch.size(), std::memory_order_relaxed);
+
+        auto error = std::current_exception();
+        for (auto& pending : batch) {
+            finish(pending, error, Committed{});
+        }
+        return false;
+    }
+
+    batches.fetch_add(1, std::memory_order_relaxed);
+    messages.fetch_add(batch.size(), std::memory_order_relaxed);
+
+    std::uint64_t peak = batch_peak.load(std::memory_order_relaxed);
+    while (batch.size() > peak && !batch_peak.compare_exchange_weak(peak, batch.size(), std::memory_order_relaxed)) {}
+
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        finish(batch[i], nullptr, Committed{ids[i], batch[i].timestamp});
+    }
+    return true;
+}
+
+// A throwing callback must not take the writer thread down with it
+void MessageWriter::finish(Pending& pending, std::exception_ptr error, const Committed& committed) {
+    try {
+        pending.done(error, committed);
+    } catch (const std::exception& e) {
+        LOG_ERROR("message commit callback failed", {"user", pending.user_id}, {"error", e.what()});
+    }
+}
+
+json MessageWriter::stats() const {
+    std::size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queued = queue.size();
+    }
+
+    std::uint64_t batch_count = batches.load(std::memory_order_relaxed);
+    std::uint64_t message_count = messages.load(std::memory_order_relaxed);
+
+    return json{
+        {"writers", threads.size()},
+        {"queued", queued},
+        {"batches", batch_count},
+        {"messages", message_count},
+        {"batch_avg", batch_count ? static_cast<double>(message_count) / batch_count : 0.0},
+        {"batch_peak", batch_peak.load(std::memory_order_relaxed)},
+        {"fallbacks", fallbacks.load(std::memory_order_relaxed)},
+        {"failed", failed.load(std::memory_order_relaxed)},
+        {"rejected", rejected.load(std::memory_order_relaxed)}
+    };
+}
+
+MessageWriter& message_writer() {
+    static MessageWriter writer = [] {
+        auto& cenv = atlas_cenv();
+
+        return MessageWriter(
+            cenv.find_number<std::size_t>("messages", "writers", 2),
+            cenv.find_number<std::size_t>("messages", "batch_size", 64),
+            cenv.find_number<std::size_t>("messages", "queue_size", 4096),
+            std::chrono::microseconds(cenv.find_number<long>("messages", "batch_window_us", 2000))
+        );
+    }();
+
+    return writer;
+}
@@ -1,5 +1,11 @@
-#include "headers/database.hpp"
 #include "headers/messaging.hpp"
+#include "headers/storage.hpp"
+#include "headers/cache.hpp"
+#include "headers/message_writer.hpp"
+#include "headers/log.hpp"
+#include "headers/json_writer.hpp"
+#include <algorithm>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <optional>
@@ -10,16 +16,6 @@
 
 using json = nlohmann::json;
 
-struct Message {
-    int id;
-    std::string server_id;
-    std::string user_id;
-    std::string content;
-    std::string timestamp;
-    std::optional<int> message_ref;
-    std::optional<std::string> link;
-};
-
 std::string getCurrentTimestamp() {
     // Get current system time
     auto now = std::chrono::system_clock::now();
@@ -48,16 +44,10 @@ json get_user_by_UUID(const std::string& UUID) {
     json result;
 
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec_params("SELECT displayname FROM users WHERE user_id = $1", UUID);
-
+        std::optional<User> user = storage().user_by_id(UUID);
+        if (!user) throw std::runtime_error("User not found");
 
-        return r[0]["displayname"].as<std::string>();
-
-        txn.commit();
+        return user->displayName;
     } catch (std::exception& e) {
         result["success"] = false;
         result["error"] = e.what();
@@ -67,140 +57,170 @@ json get_user_by_UUID(const std::string& UUID) {
     return result;
 }
 
-json get_user_all(const std::string& UUID);
+// Formats a stored SQL timestamp as 12-hour time with AM/PM
+std::string formatTime12h(const std::string& ts) {
+    std::tm tm = parseTimestamp(ts);
 
-json get_messages(const std::string serverID) {
-    json result;
-    std::vector<Message> messages;
+    std::ostringstream oss;
+    oss << std::put_time(&tm, "%I:%M %p");
+    return oss.str();
+}
 
-    try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::nontransaction txn(conn);
-
-        pqxx::result r = txn.exec(
-            "SELECT id, server_id, user_id, content, timestamp, message_ref, link "
-            "FROM messages WHERE server_id = " + txn.quote(serverID) +
-            " ORDER BY timestamp ASC;"
-        );
-
-        std::tm tm = parseTimestamp(r[0]["timestamp"].as<std::string>());
-
-        std::ostringstream oss;
-        oss << std::put_time(&tm, "%I:%M %p"); // 12-hour with AM/PM
-        std::string time12h = oss.str();
-
-        for (auto row : r) {
-            std::optional<int> message_ref = row["message_ref"].as<std::optional<int>>();
-            std::optional<std::string> link = row["link"].as<std::optional<std::string>>();
-
-            Message msg {
-                row["id"].as<int>(),
-                row["server_id"].as<std::string>(),
-                row["user_id"].as<std::string>(),
-                row["content"].c_str(),
-                time12h,
-                message_ref,
-                link
-            };
-            messages.push_back(msg);
-        }
+// History ids come from an unauthenticated route, so a ring is only seeded for
+// a server we can find; any rows at all prove it exists
+static bool server_exists(const std::string& server_id, bool has_rows) {
+    if (has_rows || membership().server(server_id)) return true;
 
-        result["success"] = true;
-        result["messages"] = json::array();
-
-        for (auto& msg : messages) {
-            json user = get_user_all(msg.user_id);
-            std::string displayName = user.value("displayName", "");
-            std::string pfp = user.value("picture", "");
-
-            json message;
-            message["id"] = msg.id;
-            message["server_id"] = msg.server_id;
-            message["displayName"] = displayName;
-            message["picture"] = pfp;
-            message["content"] = msg.content;
-            message["timestamp"] = msg.timestamp;
-            message["messageRef"] = msg.message_ref ? json(*msg.message_ref) : json(nullptr);
-            message["link"] = msg.link ? json(*msg.link) : json(nullptr);
-
-            result["messages"].push_back(message);
+    try {
+        if (auto server = storage().server(server_id)) {
+            membership().put_server(*server);
+            return true;
         }
+    } catch (const std::exception&) {}
+    return false;
+}
 
-    } catch (const std::exception& e) {
-        result["success"] = false;
-        result["error"] = e.what();
+// Writes one page of history, in ascending id order, straight into out.
+// "next_cursor" is the id to pass back as the same cursor field for the
+// following page, or null once there is nothing further in that direction.
+// The newest page is served from the server's message ring once it has been
+// seeded.
+void get_messages(const std::string serverID, const MessageCursor& cursor, JsonWriter& out) {
+    bool latest_page = !cursor.after && !cursor.before;
+    if (latest_page && message_ring().latest(serverID, cursor.limit, out)) {
+        return;
     }
 
-    return result;
-}
-
-json create_message(const std::string& user_id, const MessageFormat& message) {
-    json result;
+    // One extra row tells us whether another page exists. A newest-page miss
+    // reads a whole ring's worth so the next open is served from memory.
+    int fetch = cursor.limit + 1;
+    std::uint64_t ring_version = 0;
+    if (latest_page) {
+        ring_version = message_ring().version(serverID);
+        fetch = std::max<int>(cursor.limit, message_ring().capacity()) + 1;
+    }
 
+    std::vector<MessageFormat> r;
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
+        r = storage().messages(serverID, cursor, fetch);
+    } catch (const std::exception& e) {
+        out.begin_object();
+        out.key("error").value(e.what());
+        out.key("success").value(false);
+        out.end_object();
+        return;
+    }
 
-        pqxx::work txn(conn); // transaction
+    bool has_more = static_cast<int>(r.size()) > cursor.limit;
+    int rows = has_more ? cursor.limit : r.size();
+
+    if (latest_page && server_exists(serverID, !r.empty())) {
+        std::vector<MessageRing::Record> records;
+        records.reserve(r.size());
+
+        for (const auto& row : r) {
+            records.push_back(MessageRing::Record{
+                .id = row.id,
+                .serverID = row.serverID,
+                .userID = row.userID,
+                .displayName = row.displayName,
+                .picture = row.picture,
+                .content = row.content,
+                .timestamp = formatTime12h(row.timestamp),
+                .messageRef = row.messageRef,
+                .link = row.link
+            });
+        }
+
+        bool exhausted = static_cast<int>(r.size()) < fetch;
+        message_ring().seed(serverID, ring_version, std::move(records), exhausted);
+    }
 
-        auto time = getCurrentTimestamp();
+    // Backward pages are fetched newest-first; emit them oldest-first
+    auto row_at = [&](int i) -> const MessageFormat& {
+        return cursor.after ? r[i] : r[rows - 1 - i];
+    };
+
+    out.reserve(rows * 256);
+    out.begin_object();
+    out.key("messages").begin_array();
+
+    for (int i = 0; i < rows; ++i) {
+        const MessageFormat& row = row_at(i);
+
+        out.begin_object();
+        out.key("content").value(row.content);
+        out.key("displayName").value(row.displayName);
+        out.key("id").value(row.id);
+        out.key("link").value(row.link);
+        out.key("messageRef").value(row.messageRef);
+        out.key("picture").value(row.picture);
+        out.key("server_id").value(row.serverID);
+        out.key("timestamp").value(formatTime12h(row.timestamp));
+        out.end_object();
+    }
+    out.end_array();
 
-        std::string sql = "INSERT INTO messages (user_id, content, server_id, timestamp, message_ref, link) VALUES (" +
-            txn.quote(user_id) + ", " +
-            txn.quote(message.content) + ", " +
-            txn.quote(message.serverID) + ", " +
-            txn.quote(time) + ", " +
-            txn.quote(message.messageRef) + ", " +
-            txn.quote(message.link) + ") RETURNING id, timestamp;";
+    out.key("next_cursor");
+    if (has_more) {
+        out.value(cursor.after ? row_at(rows - 1).id : row_at(0).id);
+    } else {
+        out.null();
+    }
 
-        std::cout << "[DEBUG] SQL: " << sql << "\n";
+    out.key("success").value(true);
+    out.end_object();
+}
 
-        pqxx::result r = txn.exec(sql);
-        txn.commit();
+// Goes through the group-commit writer and returns at once; done receives the
+// result on a writer thread after the batch holding this message has committed.
+void create_message(const std::string& user_id, const MessageFormat& message, std::function<void(json)> done) {
+    auto time = getCurrentTimestamp();
 
-        if (!r.empty()) {
-            std::string message_id = r[0]["id"].as<std::string>();
-            std::tm tm = parseTimestamp(r[0]["timestamp"].as<std::string>());
+    message_writer().submit(user_id, message, time, [user_id, message, done = std::move(done)](std::exception_ptr error, const MessageWriter::Committed& committed) {
+        json result;
 
-            std::ostringstream oss;
-            oss << std::put_time(&tm, "%I:%M %p"); // 12-hour with AM/PM
-            std::string time12h = oss.str();
+        try {
+            if (error) std::rethrow_exception(error);
 
-            result["id"] = message_id;
-            result["timestamp"] = time12h;
+            result["id"] = std::to_string(committed.id);
+            result["timestamp"] = formatTime12h(committed.timestamp);
             result["success"] = true;
             result["message"] = "Message added successfully";
-        } else {
+
+            message_ring().push(MessageRing::Record{
+                .id = committed.id,
+                .serverID = message.serverID,
+                .userID = user_id,
+                .displayName = message.displayName,
+                .picture = message.picture,
+                .content = message.content,
+                .timestamp = result["timestamp"],
+                .messageRef = message.messageRef,
+                .link = message.link
+            });
+
+        } catch (const std::exception &e) {
+            LOG_ERROR("create_message failed", {"server", message.serverID}, {"error", e.what()});
             result["success"] = false;
-            result["error"] = "No ID returned";
+            result["error"] = e.what();
         }
 
-    } catch (const pqxx::sql_error &e) {
-        std::cerr << "[SQL ERROR] " << e.what() << "\nQuery: " << e.query() << "\n";
-        result["success"] = false;
-        result["error"] = e.what();
-    } catch (const std::exception &e) {
-        std::cerr << "[ERROR] " << e.what() << "\n";
-        result["success"] = false;
-        result["error"] = e.what();
-    }
-
-    return result;
+        done(std::move(result));
+    });
 }
 
 json delete_message(int message_id) {
     json result;
 
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::work txn(conn);
-        txn.exec_params("DELETE FROM messages WHERE id = $1", message_id);
-        txn.commit();
+        std::optional<std::string> server_id = storage().delete_message(message_id);
 
+        // Lets the caller fan the event out to the right server
+        if (server_id) {
+            result["server_id"] = *server_id;
+            message_ring().erase(*server_id, message_id);
+        }
         result["success"] = true;
         result["message"] = "Message deleted successfully";
     } catch(const std::exception &e) {
@@ -215,13 +235,12 @@ json edit_message(int message_id, std::string& content) {
     json result;
 
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::work txn(conn);
-        txn.exec_params("UPDATE messages SET content = $1 WHERE id = $2", content, message_id);
-        txn.commit();
+        std::optional<std::string> server_id = storage().edit_message(message_id, content);
 
+        if (server_id) {
+            result["server_id"] = *server_id;
+            message_ring().edit(*server_id, message_id, content);
+        }
         result["success"] = true;
         result["message"] = "Message edited successfully";
     } catch(const std::exception &e) {
@@ -0,0 +1,151 @@
+#include "headers/metrics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+// Upper bound of each bucket: 1.25, 1.5, 1.75, 2, 2.5, 3, 3.5, 4, 5, ...
+const std::array<double, Histogram::kBuckets>& bucket_bounds() {
+    static const auto bounds = [] {
+        std::array<double, Histogram::kBuckets> b{};
+        for (std::size_t i = 0; i < Histogram::kBuckets; ++i) {
+            double octave = std::ldexp(1.0, static_cast<int>(i / 4));
+            b[i] = octave * (1.0 + static_cast<double>(i % 4 + 1) / 4.0);
+        }
+        return b;
+    }();
+    return bounds;
+}
+
+std::string number(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "%.9g", value);
+    return buf;
+}
+
+std::string with_label(const std::string& labels, const std::string& extra) {
+    if (labels.empty()) return "{" + extra + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+void flatten(std::string& out, const std::string& prefix, const json& value) {
+    if (value.is_object()) {
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            flatten(out, prefix + "_" + it.key(), it.value());
+        }
+    } else if (value.is_number()) {
+        out += prefix + " " + number(value.get<double>()) + "\n";
+    } else if (value.is_boolean()) {
+        out += prefix + (value.get<bool>() ? " 1\n" : " 0\n");
+    }
+}
+
+}
+
+void Histogram::record(std::uint64_t value) {
+    const auto& bounds = bucket_bounds();
+    auto it = std::lower_bound(bounds.begin(), bounds.end(), static_cast<double>(value));
+
+    buckets[it - bounds.begin()].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Histogram::write(std::string& out, const std::string& name, const std::string& labels) const {
+    const auto& bounds = bucket_bounds();
+    std::uint64_t cumulative = 0;
+
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        out += name + "_bucket" + with_label(labels, "le=\"" + number(bounds[i] * scale) + "\"") + " " + std::to_string(cumulative) + "\n";
+    }
+    cumulative += buckets[kBuckets].load(std::memory_order_relaxed);
+    out += name + "_bucket" + with_label(labels, "le=\"+Inf\"") + " " + std::to_string(cumulative) + "\n";
+
+    std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+    out += name + "_sum" + suffix + " " + number(sum.load(std::memory_order_relaxed) * scale) + "\n";
+    out += name + "_count" + suffix + " " + std::to_string(count.load(std::memory_order_relaxed)) + "\n";
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Family& family = families[name];
+    family.help = help;
+    family.type = "counter";
+
+    auto& counter = family.counters[labels];
+    if (!counter) counter = std::make_unique<Counter>();
+    return *counter;
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& help, const std::string& labels, double scale) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Family& family = families[name];
+    family.help = help;
+    family.type = "histogram";
+
+    auto& histogram = family.histograms[labels];
+    if (!histogram) histogram = std::make_unique<Histogram>(scale);
+    return *histogram;
+}
+
+void Metrics::gauge(const std::string& name, const std::string& help, std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Family& family = families[name];
+    family.help = help;
+    family.type = "gauge";
+    family.gauge = std::move(read);
+}
+
+void Metrics::json_gauges(const std::string& prefix, std::function<json()> read) {
+    std::lock_guard<std::mutex> lock(mtx);
+    json_sources.emplace_back(prefix, std::move(read));
+}
+
+std::string Metrics::prometheus() {
+    std::string out;
+    std::lock_guard<std::mutex> lock(mtx);
+
+    for (const auto& [name, family] : families) {
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + family.type + "\n";
+
+        for (const auto& [labels, counter] : family.counters) {
+            out += name + (labels.empty() ? "" : "{" + labels + "}") + " " + std::to_string(counter->load()) + "\n";
+        }
+        for (const auto& [labels, histogram] : family.histograms) {
+            histogram->write(out, name, labels);
+        }
+        if (family.gauge) {
+            out += name + " " + number(family.gauge()) + "\n";
+        }
+    }
+
+    for (const auto& [prefix, read] : json_sources) {
+        flatten(out, prefix, read());
+    }
+
+    return out;
+}
+
+Metrics& metrics() {
+    static Metrics registry;
+    return registry;
+}
+
+std::string label(const std::string& key, const std::string& value) {
+    std::string out = key + "=\"";
+    for (char c : value) {
+        if (c == '\\' || c == '"') out += '\\';
+        if (c == '\n') {
+            out += "\\n";
+            continue;
+        }
+        out += c;
+    }
+    return out + "\"";
+}
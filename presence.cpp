@@ -0,0 +1,193 @@
+#include "headers/presence.hpp"
+#include "headers/storage.hpp"
+#include "headers/cache.hpp"
+#include "headers/cenv.hpp"
+#include "headers/log.hpp"
+#include <exception>
+#include <thread>
+#include <vector>
+
+static const std::string kOffline = "offline";
+
+Presence::Presence(std::chrono::milliseconds fanout_interval, std::chrono::milliseconds flush_interval)
+    : fanout_interval(fanout_interval), flush_interval(flush_interval) {}
+
+bool Presence::valid(const std::string& status) {
+    return status == "online" || status == "idle" || status == "offline";
+}
+
+const std::string& Presence::effective(const Entry& entry) {
+    return entry.sessions ? entry.chosen : kOffline;
+}
+
+void Presence::mark_locked(const std::string& user_id) {
+    updates.fetch_add(1, std::memory_order_relaxed);
+    changed.insert(user_id);
+    unsaved[user_id] = effective(entries[user_id]);
+}
+
+// Drops a user once nothing about them is left to send or save, so entries
+// track connected users rather than everyone who ever connected
+void Presence::release_locked(const std::string& user_id) {
+    auto it = entries.find(user_id);
+    if (it == entries.end() || it->second.sessions) return;
+    if (it->second.published != kOffline || changed.contains(user_id) || unsaved.contains(user_id)) return;
+
+    entries.erase(it);
+}
+
+void Presence::connect(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    Entry& entry = entries[user_id];
+    if (entry.sessions++ == 0) {
+        entry.chosen = "online";
+        mark_locked(user_id);
+    }
+}
+
+void Presence::disconnect(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = entries.find(user_id);
+    if (it == entries.end() || it->second.sessions == 0) return;
+
+    if (--it->second.sessions == 0) {
+        mark_locked(user_id);
+    }
+}
+
+void Presence::set(const std::string& user_id, const std::string& status) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = entries.find(user_id);
+    if (it == entries.end() || it->second.sessions == 0) return;
+    if (it->second.chosen == status) return;
+
+    it->second.chosen = status;
+    mark_locked(user_id);
+}
+
+std::optional<std::string> Presence::status(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = entries.find(user_id);
+    if (it == entries.end()) return std::nullopt;
+    return effective(it->second);
+}
+
+void Presence::fan_out(const Publish& publish) {
+    std::vector<std::pair<std::string, std::string>> batch;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        for (const auto& user_id : changed) {
+            Entry& entry = entries[user_id];
+            const std::string& now = effective(entry);
+
+            // Flapped back to what peers already have: nothing to send
+            if (now == entry.published) continue;
+
+            entry.published = now;
+            batch.emplace_back(user_id, now);
+        }
+
+        std::vector<std::string> settled(changed.begin(), changed.end());
+        changed.clear();
+        for (const auto& user_id : settled) {
+            release_locked(user_id);
+        }
+    }
+
+    for (const auto& [user_id, status] : batch) {
+        try {
+            publish(user_id, status);
+            published.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception& e) {
+            LOG_WARN("presence publish failed", {"user", user_id}, {"error", e.what()});
+        }
+    }
+}
+
+void Presence::flush() {
+    std::unordered_map<std::string, std::string> batch;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        batch.swap(unsaved);
+    }
+
+    if (batch.empty()) return;
+
+    try {
+        storage().set_statuses(std::vector<std::pair<std::string, std::string>>(batch.begin(), batch.end()));
+
+        for (const auto& [user_id, status] : batch) {
+            profile_cache().update(user_id, [&](User& user) {
+                user.status = status;
+            });
+        }
+        flushed.fetch_add(batch.size(), std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& [user_id, status] : batch) {
+            release_locked(user_id);
+        }
+    } catch (const std::exception& e) {
+        LOG_WARN("presence flush failed", {"users", batch.size()}, {"error", e.what()});
+
+        // Put back anything a newer change has not already superseded
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& [user_id, status] : batch) {
+            unsaved.try_emplace(user_id, std::move(status));
+        }
+    }
+}
+
+void Presence::start(Publish publish) {
+    std::thread([this, publish = std::move(publish)] {
+        auto next_flush = std::chrono::steady_clock::now() + flush_interval;
+
+        for (;;) {
+            std::this_thread::sleep_for(fanout_interval);
+            fan_out(publish);
+
+            if (std::chrono::steady_clock::now() >= next_flush) {
+                flush();
+                next_flush = std::chrono::steady_clock::now() + flush_interval;
+            }
+        }
+    }).detach();
+}
+
+json Presence::stats() {
+    std::size_t online = 0;
+    std::size_t pending;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& [user_id, entry] : entries) {
+            if (entry.sessions) online++;
+        }
+        pending = unsaved.size();
+    }
+
+    return json{
+        {"connected_users", online},
+        {"updates", updates.load(std::memory_order_relaxed)},
+        {"published", published.load(std::memory_order_relaxed)},
+        {"flushed", flushed.load(std::memory_order_relaxed)},
+        {"unsaved", pending}
+    };
+}
+
+Presence& presence() {
+    static Presence table = [] {
+        auto& cenv = atlas_cenv();
+
+        return Presence(
+            std::chrono::milliseconds(cenv.find_number<long>("presence", "fanout_ms", 250)),
+            std::chrono::milliseconds(cenv.find_number<long>("presence", "flush_ms", 5000))
+        );
+    }();
+
+    return table;
+}
@@ -0,0 +1,221 @@
+#include "headers/router.hpp"
+#include <stdexcept>
+
+namespace http = boost::beast::http;
+
+namespace {
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Malformed escapes are kept verbatim rather than rejected
+std::string percent_decode(std::string_view in, bool plus_is_space) {
+    std::string out;
+    out.reserve(in.size());
+
+    for (std::size_t i = 0; i < in.size(); ++i) {
+        if (in[i] == '%' && i + 2 < in.size() && hex_value(in[i + 1]) >= 0 && hex_value(in[i + 2]) >= 0) {
+            out += static_cast<char>(hex_value(in[i + 1]) * 16 + hex_value(in[i + 2]));
+            i += 2;
+        } else if (in[i] == '+' && plus_is_space) {
+            out += ' ';
+        } else {
+            out += in[i];
+        }
+    }
+    return out;
+}
+
+std::vector<std::string_view> split_path(std::string_view path) {
+    std::vector<std::string_view> segments;
+    if (!path.empty() && path.front() == '/') path.remove_prefix(1);
+
+    for (;;) {
+        std::size_t slash = path.find('/');
+        segments.push_back(path.substr(0, slash));
+        if (slash == std::string_view::npos) break;
+        path.remove_prefix(slash + 1);
+    }
+    return segments;
+}
+
+bool is_param(std::string_view segment) {
+    return segment.size() > 2 && segment.front() == '{' && segment.back() == '}';
+}
+
+// HEAD falls back to the GET route; the caller drops the body
+const Router::Route* route_for(const std::vector<const Router::Route*>& endpoints, http::verb method) {
+    for (const Router::Route* route : endpoints) {
+        if (route->method == method) return route;
+    }
+    if (method == http::verb::head) {
+        for (const Router::Route* route : endpoints) {
+            if (route->method == http::verb::get) return route;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+//------------------------------------------------------------
+// Route parameters
+//------------------------------------------------------------
+const std::string& RouteParams::at(std::string_view name) const {
+    for (const auto& [key, value] : values) {
+        if (key == name) return value;
+    }
+    throw std::out_of_range("missing route parameter: " + std::string(name));
+}
+
+//------------------------------------------------------------
+// Router
+//------------------------------------------------------------
+struct Router::Node {
+    std::unordered_map<std::string, std::unique_ptr<Node>, PathHash, std::equal_to<>> children;
+    std::unique_ptr<Node> param; // matches any one segment
+    std::vector<const Route*> endpoints;
+
+    // Literal segments win over parameters; backtracks if that dead-ends or
+    // lacks the method. The first path match without it is kept in allowed.
+    const Node* find(const std::vector<std::string_view>& segments, std::size_t depth, std::vector<std::string_view>& captures,
+                     http::verb method, const Node*& allowed) const {
+        if (depth == segments.size()) {
+            if (endpoints.empty()) return nullptr;
+            if (route_for(endpoints, method)) return this;
+
+            if (!allowed) allowed = this;
+            return nullptr;
+        }
+
+        auto child = children.find(segments[depth]);
+        if (child != children.end()) {
+            if (const Node* found = child->second->find(segments, depth + 1, captures, method, allowed)) return found;
+        }
+
+        if (param && !segments[depth].empty()) {
+            captures.push_back(segments[depth]);
+            if (const Node* found = param->find(segments, depth + 1, captures, method, allowed)) return found;
+            captures.pop_back();
+        }
+        return nullptr;
+    }
+};
+
+Router::Router() : root(std::make_unique<Node>()) {}
+Router::~Router() = default;
+
+void Router::add(http::verb method, const std::string& pattern, Handler handler) {
+    if (pattern.empty() || pattern.front() != '/') {
+        throw std::invalid_argument("route pattern must start with '/': " + pattern);
+    }
+
+    auto route = std::make_unique<Route>(Route{method, pattern, {}, std::move(handler)});
+    std::vector<const Route*>* endpoints = nullptr;
+
+    if (pattern.find('{') == std::string::npos) {
+        endpoints = &static_paths[pattern];
+    } else {
+        Node* node = root.get();
+        for (std::string_view segment : split_path(pattern)) {
+            if (is_param(segment)) {
+                route->param_names.emplace_back(segment.substr(1, segment.size() - 2));
+                if (!node->param) node->param = std::make_unique<Node>();
+                node = node->param.get();
+            } else {
+                auto& child = node->children[std::string(segment)];
+                if (!child) child = std::make_unique<Node>();
+                node = child.get();
+            }
+        }
+        endpoints = &node->endpoints;
+    }
+
+    for (const Route* existing : *endpoints) {
+        if (existing->method == method) {
+            throw std::logic_error("route registered twice: " + std::string(http::to_string(method)) + " " + pattern);
+        }
+    }
+
+    endpoints->push_back(route.get());
+    routes.push_back(std::move(route));
+}
+
+void Router::add(http::verb method, const std::string& pattern, std::function<Response(const Request&)> handler) {
+    add(method, pattern, Handler([handler = std::move(handler)](const Request& req, const RouteParams&) {
+        return handler(req);
+    }));
+}
+
+Router::Match Router::match(http::verb method, std::string_view target) const {
+    std::string_view path = route_path(target);
+
+    Match result;
+    const std::vector<const Route*>* allowed = nullptr;
+
+    auto fixed = static_paths.find(path);
+    if (fixed != static_paths.end()) {
+        if ((result.route = route_for(fixed->second, method))) return result;
+        allowed = &fixed->second;
+    }
+
+    // A pattern may still take the method a literal path lacks
+    std::vector<std::string_view> segments = split_path(path);
+    std::vector<std::string_view> captures;
+    const Node* allowed_node = nullptr;
+
+    if (const Node* node = root->find(segments, 0, captures, method, allowed_node)) {
+        result.route = route_for(node->endpoints, method);
+        for (std::size_t i = 0; i < captures.size(); ++i) {
+            result.params.values.emplace_back(result.route->param_names[i], percent_decode(captures[i], false));
+        }
+        return result;
+    }
+
+    if (!allowed && allowed_node) allowed = &allowed_node->endpoints;
+    if (!allowed) return result;
+
+    bool has_get = false;
+    bool has_head = false;
+    for (const Route* route : *allowed) {
+        if (!result.allow.empty()) result.allow += ", ";
+        result.allow += std::string(http::to_string(route->method));
+
+        has_get = has_get || route->method == http::verb::get;
+        has_head = has_head || route->method == http::verb::head;
+    }
+    if (has_get && !has_head) result.allow += ", HEAD";
+
+    return result;
+}
+
+//------------------------------------------------------------
+// Target helpers
+//------------------------------------------------------------
+std::string_view route_path(std::string_view target) {
+    return target.substr(0, target.find('?'));
+}
+
+std::optional<std::string> query_param(const Router::Request& req, std::string_view key) {
+    std::string_view target{req.target().data(), req.target().size()};
+
+    std::size_t query = target.find('?');
+    if (query == std::string_view::npos) return std::nullopt;
+    target.remove_prefix(query + 1);
+
+    while (!target.empty()) {
+        std::size_t amp = target.find('&');
+        std::string_view pair = target.substr(0, amp);
+        target.remove_prefix(amp == std::string_view::npos ? target.size() : amp + 1);
+
+        std::size_t eq = pair.find('=');
+        if (percent_decode(pair.substr(0, eq), true) != key) continue;
+
+        return eq == std::string_view::npos ? std::string() : percent_decode(pair.substr(eq + 1), true);
+    }
+    return std::nullopt;
+}
@@ -2,6 +2,9 @@
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include "headers/database.hpp"
+#include "headers/storage.hpp"
+#include "headers/cache.hpp"
+#include "headers/presence.hpp"
 #include <exception>
 #include <nlohmann/json.hpp>
 #include <iostream>
@@ -9,41 +12,60 @@
 
 using json = nlohmann::json;
 
+// Status comes from the live presence table; users it has never seen are offline
+static json member_json(const User& user) {
+    return json{
+        {"displayName", user.displayName},
+        {"status", presence().status(user.userid).value_or("offline")},
+        {"picture", user.picture},
+        {"customStatus", user.customStatus},
+        {"userid", user.userid},
+        {"bio", user.bio}
+    };
+}
+
 json server_get_all_users(const std::string server_id) {
     json response;
 
+    // Answer from memory only when every member's profile is still cached;
+    // one evicted profile sends the whole list back to the database
+    if (auto members = membership().members_of(server_id)) {
+        json list = json::array();
+        bool complete = true;
+
+        for (const auto& user_id : *members) {
+            auto user = profile_cache().get(user_id);
+            if (!user) {
+                complete = false;
+                break;
+            }
+            list.push_back(member_json(*user));
+        }
+
+        if (complete && !list.empty()) {
+            response["user_list"] = std::move(list);
+            response["status"] = 200;
+            return response;
+        }
+    }
+
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
+        std::vector<User> users = storage().members_of(server_id);
 
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec_params(
-            "SELECT u.displayname, u.profile_picture, u.appearance_status, u.custom_status, u.user_id, u.bio "
-            "FROM users u "
-            "JOIN user_servers us ON u.user_id = us.uid "
-            "WHERE us.sid = $1",
-            server_id
-        );
+        std::vector<std::string> members;
+        members.reserve(users.size());
 
-        for (auto row : r) {
-            std::string displayname = row["displayname"].as<std::string>();
-            std::string picture = row["profile_picture"].as<std::string>();
-            std::string status = row["appearance_status"].as<std::string>();
-            std::string uscms = row["custom_status"].as<std::string>();
-            std::string user_id = row["user_id"].as<std::string>();
-            std::string bio = row["bio"].as<std::string>();
-
-            response["user_list"].push_back({
-                {"displayName", displayname},
-                {"status", status},
-                {"picture", picture},
-                {"customStatus", uscms},
-                {"userid", user_id},
-                {"bio", bio}
-            });
+        for (auto& user : users) {
+            response["user_list"].push_back(member_json(user));
             response["status"] = 200;
+
+            // put() takes the key by reference; moving user would empty it first
+            members.push_back(user.userid);
+            profile_cache().put(members.back(), std::move(user));
         };
 
+        membership().load_server(server_id, members);
+
 
     } catch (std::exception &e) {
         std::cout << e.what() << "\n";
@@ -57,23 +79,27 @@ json server_get_all_users(const std::string server_id) {
 json get_server(const std::string server_id) {
     json response;
 
-    try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
+    if (auto cached = membership().server(server_id)) {
+        response["server"] = {
+            {"server_name", cached->name},
+            {"owner", cached->owner}
+        };
+        response["status"] = 200;
+        return response;
+    }
 
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec_params("SELECT * FROM servers WHERE server_id = $1", server_id);
+    try {
+        std::optional<Server> server = storage().server(server_id);
 
-        if (r.empty()) {
+        if (!server) {
             std::cout << "Server not found" << "\n";
             return json{{"status", "failed"}};
         } else {
-            std::string server_name = r[0]["server_name"].as<std::string>();
-            std::string owner = r[0]["owner"].as<std::string>();
+            membership().put_server(*server);
 
             response["server"] = {
-                {"server_name", server_name},
-                {"owner", owner}
+                {"server_name", server->name},
+                {"owner", server->owner}
             };
             response["status"] = 200;
         }
@@ -89,21 +115,17 @@ json join_server(const std::string server_id, const std::string UUID) {
     json response;
 
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
-
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec_params("INSERT INTO user_servers (sid, uid) VALUES (" + txn.quote(server_id) + ", " + txn.quote(UUID) + ") RETURNING sid;");
+        storage().join_server(server_id, UUID);
 
-        txn.commit();
+        membership().add_member(server_id, UUID);
 
-        std::string sid = r[0]["sid"].as<std::string>();
+        json server = get_server(server_id)["server"];
         response["server"] = {
-            {"name", get_server(sid)["server"].value("server_name", "")},
-            {"owner", get_server(sid)["server"].value("owner", "")},
-            {"serverID", sid},
+            {"name", server.value("server_name", "")},
+            {"owner", server.value("owner", "")},
+            {"serverID", server_id},
         };
-    } catch (const pqxx::unique_violation) {
+    } catch (const AlreadyMember&) {
         response["server"] = {
             {"status", 409},
             {"message", "User is already in server"}
@@ -123,30 +145,17 @@ json create_server(const std::string serverName, const std::string UUID) {
     std::string server_id = to_string(id);
 
     try {
-        Database db = connect_db();
-        auto& conn = db.getConnection();
+        Server server{server_id, serverName, UUID};
+        storage().create_server(server);
 
-        pqxx::work txn(conn);
-        pqxx::result r = txn.exec("INSERT INTO servers (server_name, server_id, owner) values (" + txn.quote(serverName) + ", " + txn.quote(server_id) + ", " + txn.quote(UUID) + ") RETURNING *;");
-        
-        txn.commit();
-
-        if (r.empty()) {
-            std::cout << "Server creation failed";
-            response["error"] = "Server creation failed";
-            response["status"] = 404;
-        } else {
-            std::string server_name = r[0]["server_name"].as<std::string>();
-            std::string server_id = r[0]["server_id"].as<std::string>();
-            std::string owner = r[0]["owner"].as<std::string>();
-            response["server"] = {
-                {"serverName", server_name},
-                {"serverID", server_id},
-                {"ownerID", owner},
-            };
-            response["status"] = 200;
-        }
+        membership().put_server(server);
 
+        response["server"] = {
+            {"serverName", server.name},
+            {"serverID", server.serverID},
+            {"ownerID", server.owner},
+        };
+        response["status"] = 200;
 
     } catch (std::exception &e) {
         std::cout << e.what() << "\n";
@@ -161,7 +170,7 @@ json update_server() {
     json response;
 
     try {
-        Database db = connect_db();
+        auto db = connect_db();
         auto& conn = db.getConnection();
 
         pqxx::work txn(conn);
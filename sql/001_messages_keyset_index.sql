@@ -0,0 +1,14 @@
+-- Keyset pagination over a server's history (get_messages_before/after/latest
+-- in statements.cpp). Run once against the live database, outside a
+-- transaction block:
+--
+--   psql atlas -f sql/001_messages_keyset_index.sql
+--
+-- A failed concurrent build leaves an INVALID index that IF NOT EXISTS would
+-- then skip, so check afterwards that this returns no rows:
+--
+--   SELECT indexrelid::regclass FROM pg_index WHERE NOT indisvalid;
+--
+-- and if it lists this index, DROP INDEX CONCURRENTLY it and run the file again.
+
+CREATE INDEX CONCURRENTLY IF NOT EXISTS messages_server_id_id_idx ON messages (server_id, id);
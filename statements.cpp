@@ -0,0 +1,119 @@
+#include "headers/statements.hpp"
+#include "headers/metrics.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace {
+
+constexpr std::size_t kStatementCount = static_cast<std::size_t>(Stmt::count);
+
+// Indexed by Stmt; keep in the same order as the enum
+const std::array<PreparedStatement, kStatementCount> kStatements{{
+    {"user_exists",
+        "SELECT 1 FROM users WHERE username = $1 LIMIT 1"},
+    {"create_account",
+        "INSERT INTO users (username, displayname, password, user_id, appearance_status, custom_status, bio) "
+        "VALUES ($1, $2, $3, $4, $5, $6, $7)"},
+    {"update_account",
+        "UPDATE users SET username = $1, displayname = $2, profile_picture = $3, custom_status = $4, bio = $5 "
+        "WHERE user_id = $6"},
+    {"login_user",
+        "SELECT password FROM users WHERE username = $1 LIMIT 1"},
+    {"get_user",
+        "SELECT * FROM users WHERE username = $1"},
+    {"get_user_all",
+        "SELECT * FROM users WHERE user_id = $1"},
+    {"user_get_all_servers",
+        "SELECT s.server_id, s.server_name, s.owner "
+        "FROM servers s "
+        "JOIN user_servers us ON s.server_id = us.sid "
+        "WHERE us.uid = $1"},
+    {"set_user_appearance_status",
+        "UPDATE users SET appearance_status = $1 WHERE user_id = $2 RETURNING appearance_status"},
+    {"get_messages_latest",
+        "SELECT m.id, m.server_id, m.user_id, m.content, m.timestamp, m.message_ref, m.link, "
+        "u.displayname, u.profile_picture "
+        "FROM messages m "
+        "LEFT JOIN users u ON u.user_id = m.user_id "
+        "WHERE m.server_id = $1 "
+        "ORDER BY m.id DESC LIMIT $2"},
+    {"get_messages_before",
+        "SELECT m.id, m.server_id, m.user_id, m.content, m.timestamp, m.message_ref, m.link, "
+        "u.displayname, u.profile_picture "
+        "FROM messages m "
+        "LEFT JOIN users u ON u.user_id = m.user_id "
+        "WHERE m.server_id = $1 AND m.id < $2 "
+        "ORDER BY m.id DESC LIMIT $3"},
+    {"get_messages_after",
+        "SELECT m.id, m.server_id, m.user_id, m.content, m.timestamp, m.message_ref, m.link, "
+        "u.displayname, u.profile_picture "
+        "FROM messages m "
+        "LEFT JOIN users u ON u.user_id = m.user_id "
+        "WHERE m.server_id = $1 AND m.id > $2 "
+        "ORDER BY m.id ASC LIMIT $3"},
+    {"reserve_message_ids",
+        "SELECT nextval(pg_get_serial_sequence('messages', 'id')) AS id FROM generate_series(1, $1)"},
+    {"insert_messages",
+        "INSERT INTO messages (id, user_id, content, server_id, timestamp, message_ref, link) "
+        "SELECT * FROM unnest($1::int[], $2::text[], $3::text[], $4::text[], $5::timestamp[], $6::int[], $7::text[])"},
+    {"delete_message",
+        "DELETE FROM messages WHERE id = $1 RETURNING server_id"},
+    {"edit_message",
+        "UPDATE messages SET content = $1 WHERE id = $2 RETURNING server_id"},
+    {"server_get_all_users",
+        "SELECT u.username, u.displayname, u.profile_picture, u.appearance_status, u.custom_status, u.user_id, u.bio "
+        "FROM users u "
+        "JOIN user_servers us ON u.user_id = us.uid "
+        "WHERE us.sid = $1"},
+    {"get_server",
+        "SELECT * FROM servers WHERE server_id = $1"},
+    {"join_server",
+        "INSERT INTO user_servers (sid, uid) VALUES ($1, $2) RETURNING sid"},
+    {"create_server",
+        "INSERT INTO servers (server_name, server_id, owner) VALUES ($1, $2, $3) RETURNING *"},
+    {"verify_invite",
+        "SELECT i.issued_by, i.sid "
+        "FROM server_invites i "
+        "WHERE code = $1"},
+}};
+
+std::array<std::atomic<std::uint64_t>, kStatementCount> executions{};
+
+}
+
+const PreparedStatement& statement(Stmt id) {
+    return kStatements[static_cast<std::size_t>(id)];
+}
+
+void prepare_statements(pqxx::connection& conn) {
+    for (const auto& stmt : kStatements) {
+        conn.prepare(stmt.name, stmt.sql);
+    }
+}
+
+void count_statement(Stmt id) {
+    executions[static_cast<std::size_t>(id)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void record_statement(Stmt id, std::chrono::steady_clock::duration elapsed) {
+    static const auto latency = [] {
+        std::array<Histogram*, kStatementCount> h{};
+        for (std::size_t i = 0; i < kStatementCount; ++i) {
+            h[i] = &metrics().histogram("atlas_db_query_duration_seconds", "Prepared statement round trip", label("statement", kStatements[i].name));
+        }
+        return h;
+    }();
+
+    latency[static_cast<std::size_t>(id)]->record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+json statement_stats() {
+    json stats = json::object();
+
+    for (std::size_t i = 0; i < kStatementCount; ++i) {
+        stats[kStatements[i].name] = executions[i].load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
@@ -0,0 +1,35 @@
+#include "headers/storage.hpp"
+#include "headers/cenv.hpp"
+#include <iostream>
+#include <mutex>
+
+static std::string& requested_backend() {
+    static std::string backend;
+    return backend;
+}
+
+void use_storage(const std::string& backend) {
+    requested_backend() = backend;
+}
+
+Storage& storage() {
+    static std::unique_ptr<Storage> instance = [] {
+        std::string backend = requested_backend();
+
+        if (backend.empty()) {
+            backend = atlas_cenv().find_token("storage", "backend");
+        }
+
+        if (backend == "memory") {
+            return make_memory_storage();
+        }
+        return make_postgres_storage();
+    }();
+
+    static std::once_flag announced;
+    std::call_once(announced, [] {
+        std::cout << "[Storage] Using " << instance->name() << " backend\n";
+    });
+
+    return *instance;
+}
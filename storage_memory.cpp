@@ -0,0 +1,262 @@
+#include "headers/storage.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Process-local backend for profiling the server without a database and for
+// fixtures. Same contract as Postgres; nothing survives a restart. One
+// reader/writer lock covers everything, which is plenty for those uses.
+class MemoryStorage : public Storage {
+public:
+    // Starts with the fixture row of bench/schema.sql, so bench/loadgen runs
+    // against --storage memory just as it does against the scratch database
+    MemoryStorage() {
+        servers.emplace("bench-server", Server{.serverID = "bench-server", .name = "Bench", .owner = "bench"});
+    }
+
+    const char* name() const override { return "memory"; }
+
+    bool user_exists(const std::string& username) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        return by_name.contains(username);
+    }
+
+    void create_user(const User& user, const std::string& password_hash) override {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        if (by_name.contains(user.username)) {
+            throw std::runtime_error("duplicate username: " + user.username);
+        }
+
+        users[user.userid] = Account{user, password_hash};
+        by_name[user.username] = user.userid;
+    }
+
+    void update_user(const User& user) override {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        auto it = users.find(user.userid);
+        if (it == users.end()) return;
+
+        User& stored = it->second.user;
+        if (stored.username != user.username) {
+            if (by_name.contains(user.username)) {
+                throw std::runtime_error("duplicate username: " + user.username);
+            }
+            by_name.erase(stored.username);
+            by_name[user.username] = user.userid;
+        }
+
+        // Status belongs to presence, not to profile edits
+        std::string status = stored.status;
+        stored = user;
+        stored.status = status;
+    }
+
+    std::optional<std::string> password_hash(const std::string& username) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        const Account* account = account_by_name(username);
+        if (!account) return std::nullopt;
+        return account->password_hash;
+    }
+
+    std::optional<User> user_by_name(const std::string& username) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        const Account* account = account_by_name(username);
+        if (!account) return std::nullopt;
+        return account->user;
+    }
+
+    std::optional<User> user_by_id(const std::string& user_id) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        auto it = users.find(user_id);
+        if (it == users.end()) return std::nullopt;
+        return it->second.user;
+    }
+
+    void set_statuses(const std::vector<std::pair<std::string, std::string>>& statuses) override {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        for (const auto& [user_id, status] : statuses) {
+            auto it = users.find(user_id);
+            if (it != users.end()) it->second.user.status = status;
+        }
+    }
+
+    std::vector<Server> servers_of(const std::string& user_id) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        std::vector<Server> result;
+        auto it = user_servers.find(user_id);
+        if (it == user_servers.end()) return result;
+
+        for (const auto& server_id : it->second) {
+            auto server = servers.find(server_id);
+            if (server != servers.end()) result.push_back(server->second);
+        }
+        return result;
+    }
+
+    std::vector<User> members_of(const std::string& server_id) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        std::vector<User> result;
+        auto it = server_members.find(server_id);
+        if (it == server_members.end()) return result;
+
+        for (const auto& user_id : it->second) {
+            auto user = users.find(user_id);
+            if (user != users.end()) result.push_back(user->second.user);
+        }
+        return result;
+    }
+
+    std::optional<Server> server(const std::string& server_id) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        auto it = servers.find(server_id);
+        if (it == servers.end()) return std::nullopt;
+        return it->second;
+    }
+
+    void create_server(const Server& server) override {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        if (!servers.try_emplace(server.serverID, server).second) {
+            throw std::runtime_error("duplicate server: " + server.serverID);
+        }
+    }
+
+    void join_server(const std::string& server_id, const std::string& user_id) override {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        if (!servers.contains(server_id) || !users.contains(user_id)) {
+            throw std::runtime_error("unknown server or user");
+        }
+        if (!server_members[server_id].insert(user_id).second) {
+            throw AlreadyMember();
+        }
+        user_servers[user_id].insert(server_id);
+    }
+
+    std::optional<Invite> invite(const std::string& code) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        auto it = invites.find(code);
+        if (it == invites.end()) return std::nullopt;
+        return it->second;
+    }
+
+    std::vector<MessageFormat> messages(const std::string& server_id, const MessageCursor& cursor, int fetch) override {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+
+        std::vector<MessageFormat> rows;
+        auto it = history.find(server_id);
+        if (it == history.end() || fetch <= 0) return rows;
+
+        const auto& log = it->second; // id → message, ascending
+
+        if (cursor.after) {
+            for (auto m = log.upper_bound(*cursor.after); m != log.end() && rows.size() < static_cast<std::size_t>(fetch); ++m) {
+                rows.push_back(with_author(m->second));
+            }
+            return rows;
+        }
+
+        auto end = cursor.before ? log.lower_bound(*cursor.before) : log.end();
+        for (auto m = std::make_reverse_iterator(end); m != log.rend() && rows.size() < static_cast<std::size_t>(fetch); ++m) {
+            rows.push_back(with_author(m->second));
+        }
+        return rows;
+    }
+
+    std::vector<int> insert_messages(const std::vector<MessageFormat>& batch) override {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        std::vector<int> ids;
+        ids.reserve(batch.size());
+
+        for (const auto& message : batch) {
+            MessageFormat stored = message;
+            stored.id = ++last_message_id;
+
+            ids.push_back(stored.id);
+            message_server[stored.id] = stored.serverID;
+            history[stored.serverID].emplace(stored.id, std::move(stored));
+        }
+        return ids;
+    }
+
+    std::optional<std::string> delete_message(int message_id) override {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        auto it = message_server.find(message_id);
+        if (it == message_server.end()) return std::nullopt;
+
+        std::string server_id = it->second;
+        history[server_id].erase(message_id);
+        message_server.erase(it);
+        return server_id;
+    }
+
+    std::optional<std::string> edit_message(int message_id, const std::string& content) override {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+
+        auto it = message_server.find(message_id);
+        if (it == message_server.end()) return std::nullopt;
+
+        history[it->second][message_id].content = content;
+        return it->second;
+    }
+
+private:
+    struct Account {
+        User user;
+        std::string password_hash;
+    };
+
+    std::shared_mutex mtx;
+
+    std::unordered_map<std::string, Account> users;           // user_id → account
+    std::unordered_map<std::string, std::string> by_name;     // username → user_id
+    std::unordered_map<std::string, Server> servers;
+    std::unordered_map<std::string, std::unordered_set<std::string>> user_servers;
+    std::unordered_map<std::string, std::unordered_set<std::string>> server_members;
+    std::unordered_map<std::string, Invite> invites;
+
+    std::unordered_map<std::string, std::map<int, MessageFormat>> history;
+    std::unordered_map<int, std::string> message_server;
+    int last_message_id = 0;
+
+    const Account* account_by_name(const std::string& username) const {
+        auto id = by_name.find(username);
+        if (id == by_name.end()) return nullptr;
+
+        auto it = users.find(id->second);
+        return it == users.end() ? nullptr : &it->second;
+    }
+
+    // Mirrors the LEFT JOIN on users: current name and picture, empty if gone
+    MessageFormat with_author(const MessageFormat& message) const {
+        MessageFormat row = message;
+
+        auto it = users.find(message.userID);
+        row.displayName = it == users.end() ? "" : it->second.user.displayName;
+        row.picture = it == users.end() ? "" : it->second.user.picture;
+        return row;
+    }
+};
+
+}
+
+std::unique_ptr<Storage> make_memory_storage() {
+    return std::make_unique<MemoryStorage>();
+}
@@ -0,0 +1,250 @@
+#include "headers/storage.hpp"
+#include "headers/database.hpp"
+#include "headers/statements.hpp"
+
+namespace {
+
+User user_from_row(const pqxx::row& row) {
+    return User{
+        .username = row["username"].c_str(),
+        .userid = row["user_id"].c_str(),
+        .displayName = row["displayname"].c_str(),
+        .status = row["appearance_status"].c_str(),
+        .picture = row["profile_picture"].c_str(),
+        .customStatus = row["custom_status"].c_str(),
+        .bio = row["bio"].c_str()
+    };
+}
+
+class PostgresStorage : public Storage {
+public:
+    const char* name() const override { return "postgres"; }
+
+    bool user_exists(const std::string& username) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+        return !exec_stmt(txn, Stmt::user_exists, username).empty();
+    }
+
+    void create_user(const User& user, const std::string& password_hash) override {
+        auto db = connect_db();
+        pqxx::work txn(db.getConnection());
+        exec_stmt(txn, Stmt::create_account, user.username, user.displayName, password_hash, user.userid, user.status, user.customStatus, user.bio);
+        txn.commit();
+    }
+
+    void update_user(const User& user) override {
+        auto db = connect_db();
+        pqxx::work txn(db.getConnection());
+        exec_stmt(txn, Stmt::update_account, user.username, user.displayName, user.picture, user.customStatus, user.bio, user.userid);
+        txn.commit();
+    }
+
+    std::optional<std::string> password_hash(const std::string& username) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+
+        pqxx::result r = exec_stmt(txn, Stmt::login_user, username);
+        if (r.empty()) return std::nullopt;
+        return std::string(r[0]["password"].c_str());
+    }
+
+    std::optional<User> user_by_name(const std::string& username) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+
+        pqxx::result r = exec_stmt(txn, Stmt::get_user, username);
+        if (r.empty()) return std::nullopt;
+        return user_from_row(r[0]);
+    }
+
+    std::optional<User> user_by_id(const std::string& user_id) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+
+        pqxx::result r = exec_stmt(txn, Stmt::get_user_all, user_id);
+        if (r.empty()) return std::nullopt;
+        return user_from_row(r[0]);
+    }
+
+    void set_statuses(const std::vector<std::pair<std::string, std::string>>& statuses) override {
+        auto db = connect_db();
+        pqxx::work txn(db.getConnection());
+
+        for (const auto& [user_id, status] : statuses) {
+            exec_stmt(txn, Stmt::set_user_appearance_status, status, user_id);
+        }
+        txn.commit();
+    }
+
+    std::vector<Server> servers_of(const std::string& user_id) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+
+        std::vector<Server> servers;
+        for (auto row : exec_stmt(txn, Stmt::user_get_all_servers, user_id)) {
+            servers.push_back(Server{
+                .serverID = row["server_id"].as<std::string>(),
+                .name = row["server_name"].c_str(),
+                .owner = row["owner"].c_str()
+            });
+        }
+        return servers;
+    }
+
+    std::vector<User> members_of(const std::string& server_id) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+
+        std::vector<User> members;
+        for (auto row : exec_stmt(txn, Stmt::server_get_all_users, server_id)) {
+            members.push_back(user_from_row(row));
+        }
+        return members;
+    }
+
+    std::optional<Server> server(const std::string& server_id) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+
+        pqxx::result r = exec_stmt(txn, Stmt::get_server, server_id);
+        if (r.empty()) return std::nullopt;
+
+        return Server{
+            .serverID = server_id,
+            .name = r[0]["server_name"].as<std::string>(),
+            .owner = r[0]["owner"].as<std::string>()
+        };
+    }
+
+    void create_server(const Server& server) override {
+        auto db = connect_db();
+        pqxx::work txn(db.getConnection());
+        exec_stmt(txn, Stmt::create_server, server.name, server.serverID, server.owner);
+        txn.commit();
+    }
+
+    void join_server(const std::string& server_id, const std::string& user_id) override {
+        try {
+            auto db = connect_db();
+            pqxx::work txn(db.getConnection());
+            exec_stmt(txn, Stmt::join_server, server_id, user_id);
+            txn.commit();
+        } catch (const pqxx::unique_violation&) {
+            throw AlreadyMember();
+        }
+    }
+
+    std::optional<Invite> invite(const std::string& code) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+
+        pqxx::result r = exec_stmt(txn, Stmt::verify_invite, code);
+        if (r.empty()) return std::nullopt;
+
+        return Invite{
+            .code = code,
+            .issuedBy = r[0]["issued_by"].as<std::string>(),
+            .serverID = r[0]["sid"].as<std::string>()
+        };
+    }
+
+    std::vector<MessageFormat> messages(const std::string& server_id, const MessageCursor& cursor, int fetch) override {
+        auto db = connect_db();
+        pqxx::nontransaction txn(db.getConnection());
+
+        // Author columns come from the same query instead of one lookup per row
+        pqxx::result r;
+        if (cursor.after) {
+            r = exec_stmt(txn, Stmt::get_messages_after, server_id, *cursor.after, fetch);
+        } else if (cursor.before) {
+            r = exec_stmt(txn, Stmt::get_messages_before, server_id, *cursor.before, fetch);
+        } else {
+            r = exec_stmt(txn, Stmt::get_messages_latest, server_id, fetch);
+        }
+
+        std::vector<MessageFormat> rows;
+        rows.reserve(r.size());
+
+        for (auto row : r) {
+            rows.push_back(MessageFormat{
+                .id = row["id"].as<int>(),
+                .picture = row["profile_picture"].as<std::optional<std::string>>().value_or(""),
+                .displayName = row["displayname"].as<std::optional<std::string>>().value_or(""),
+                .serverID = row["server_id"].as<std::string>(),
+                .content = row["content"].c_str(),
+                .timestamp = row["timestamp"].as<std::string>(),
+                .messageRef = row["message_ref"].as<std::optional<int>>(),
+                .link = row["link"].as<std::optional<std::string>>(),
+                .userID = row["user_id"].as<std::optional<std::string>>().value_or("")
+            });
+        }
+        return rows;
+    }
+
+    std::vector<int> insert_messages(const std::vector<MessageFormat>& messages) override {
+        try {
+            auto db = connect_db();
+            pqxx::work txn(db.getConnection());
+
+            // Ids are reserved up front so each sender gets its own back without
+            // relying on the row order of a multi-row RETURNING
+            std::vector<int> ids;
+            ids.reserve(messages.size());
+            for (auto row : exec_stmt(txn, Stmt::reserve_message_ids, static_cast<int>(messages.size()))) {
+                ids.push_back(row["id"].as<int>());
+            }
+
+            // One prepared statement for any batch size: each column goes over as an array
+            std::vector<std::string> users, contents, servers, timestamps;
+            std::vector<std::optional<int>> refs;
+            std::vector<std::optional<std::string>> links;
+
+            for (const MessageFormat& m : messages) {
+                users.push_back(m.userID);
+                contents.push_back(m.content);
+                servers.push_back(m.serverID);
+                timestamps.push_back(m.timestamp);
+                refs.push_back(m.messageRef);
+                links.push_back(m.link);
+            }
+
+            exec_stmt(txn, Stmt::insert_messages, ids, users, contents, servers, timestamps, refs, links);
+            txn.commit();
+
+            return ids;
+        } catch (const pqxx::data_exception& e) {
+            throw RowRejected(e.what());
+        } catch (const pqxx::integrity_constraint_violation& e) {
+            throw RowRejected(e.what());
+        }
+    }
+
+    std::optional<std::string> delete_message(int message_id) override {
+        auto db = connect_db();
+        pqxx::work txn(db.getConnection());
+
+        pqxx::result r = exec_stmt(txn, Stmt::delete_message, message_id);
+        txn.commit();
+
+        if (r.empty()) return std::nullopt;
+        return r[0]["server_id"].as<std::string>();
+    }
+
+    std::optional<std::string> edit_message(int message_id, const std::string& content) override {
+        auto db = connect_db();
+        pqxx::work txn(db.getConnection());
+
+        pqxx::result r = exec_stmt(txn, Stmt::edit_message, content, message_id);
+        txn.commit();
+
+        if (r.empty()) return std::nullopt;
+        return r[0]["server_id"].as<std::string>();
+    }
+};
+
+}
+
+std::unique_ptr<Storage> make_postgres_storage() {
+    return std::make_unique<PostgresStorage>();
+}
@@ -0,0 +1,90 @@
+#include "headers/worker_pool.hpp"
+#include "headers/cenv.hpp"
+#include "headers/log.hpp"
+#include <algorithm>
+#include <exception>
+
+WorkerPool::WorkerPool(std::size_t workers, std::size_t max_queue) : max_queue(max_queue) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(workers, 1); ++i) {
+        threads.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    ready.notify_all();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+bool WorkerPool::try_submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (queue.size() >= max_queue) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        queue.push_back(std::move(task));
+        queue_peak = std::max(queue_peak, queue.size());
+    }
+
+    ready.notify_one();
+    return true;
+}
+
+void WorkerPool::work() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+
+            if (stopping && queue.empty()) return;
+
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("worker task failed", {"error", e.what()});
+        }
+        completed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+json WorkerPool::stats() const {
+    std::size_t depth;
+    std::size_t peak;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        depth = queue.size();
+        peak = queue_peak;
+    }
+
+    return json{
+        {"workers", threads.size()},
+        {"queue_limit", max_queue},
+        {"queue_depth", depth},
+        {"queue_peak", peak},
+        {"rejected", rejected.load(std::memory_order_relaxed)},
+        {"completed", completed.load(std::memory_order_relaxed)}
+    };
+}
+
+WorkerPool& worker_pool() {
+    static WorkerPool pool(
+        atlas_cenv().find_number<std::size_t>("workers", "threads", 16),
+        atlas_cenv().find_number<std::size_t>("workers", "queue_size", 1024)
+    );
+
+    return pool;
+}
@@ -0,0 +1,53 @@
+#include "headers/ws_codec.hpp"
+
+namespace {
+
+std::string_view trim(std::string_view text) {
+    std::size_t start = text.find_first_not_of(" \t");
+    if (start == std::string_view::npos) return {};
+
+    std::size_t end = text.find_last_not_of(" \t");
+    return text.substr(start, end - start + 1);
+}
+
+}
+
+std::optional<WsCodec> ws_negotiate(std::string_view offered) {
+    while (!offered.empty()) {
+        std::size_t comma = offered.find(',');
+        std::string_view protocol = trim(offered.substr(0, comma));
+        offered.remove_prefix(comma == std::string_view::npos ? offered.size() : comma + 1);
+
+        if (protocol == "atlas.msgpack") return WsCodec::msgpack;
+        if (protocol == "atlas.cbor") return WsCodec::cbor;
+        if (protocol == "atlas.json") return WsCodec::json;
+    }
+    return std::nullopt;
+}
+
+const char* ws_protocol_name(WsCodec codec) {
+    switch (codec) {
+        case WsCodec::msgpack: return "atlas.msgpack";
+        case WsCodec::cbor:    return "atlas.cbor";
+        default:               return "atlas.json";
+    }
+}
+
+std::string ws_encode(const json& event, WsCodec codec) {
+    std::string frame;
+
+    switch (codec) {
+        case WsCodec::msgpack: json::to_msgpack(event, frame); break;
+        case WsCodec::cbor:    json::to_cbor(event, frame); break;
+        default:               frame = event.dump();
+    }
+    return frame;
+}
+
+json ws_decode(std::string_view frame, WsCodec codec) {
+    switch (codec) {
+        case WsCodec::msgpack: return json::from_msgpack(frame.begin(), frame.end());
+        case WsCodec::cbor:    return json::from_cbor(frame.begin(), frame.end());
+        default:               return json::parse(frame.begin(), frame.end());
+    }
+}